@@ -0,0 +1,101 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "bench.h"
+#include "../src/Filter.h"
+#include "../src/Fold.h"
+#include "../src/ForEach.h"
+#include "../src/Map.h"
+#include "../src/Take.h"
+
+// Summing a Map -> Filter -> Take pipeline over a vector a block at a time, for several
+// block sizes, against pushing single items through it (Fold). Each stage runs a loop of
+// its own over each block, which the compiler vectorises, Filter moving the passing items
+// down with SIMD, and the blocks are summed likewise (with for_block). Blocks of 16 are too
+// short to pay for the calls per block.
+//
+// Before the first case is timed, every block size is checked against Fold, as is a Map
+// to items which can't be default constructed (which go a block of one at a time). The
+// program stops if any sum differs.
+
+namespace {
+
+const long N = 1 << 22;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+auto times3 = [](int x) { return x * 3 + 1; };
+auto even = [](int x) { return x % 2 == 0; };
+
+int folded() {
+  auto m = FIter::Map(times3)(v.begin(), v.end());
+  auto f = FIter::Filter(even)(m.begin(), m.end());
+  auto t = FIter::Take(N / 4)(f.begin(), f.end());
+  return FIter::Fold(0, [](int a, int x) { return a + x; })(t);
+}
+
+template <std::size_t B>
+int batched() {
+  auto m = FIter::Map(times3)(v.begin(), v.end());
+  auto f = FIter::Filter(even)(m.begin(), m.end());
+  auto t = FIter::Take(N / 4)(f.begin(), f.end());
+  int sum = 0;
+  FIter::ForEachBatch<B>([&sum](int* items, std::size_t n) {
+    int block = 0;
+    FIter::for_block(n, [&](std::size_t i) { block += items[i]; });
+    sum += block;
+  })(t);
+  return sum;
+}
+
+// Can't be default constructed, so can't be kept in a block.
+struct Boxed {
+  int x;
+  explicit Boxed(int _x) : x(_x) {}
+};
+
+void expect_sum(const char* name, long sum, long expected) {
+  if(sum != expected) {
+    std::fprintf(stderr, "batch %s: sum %ld, but Fold gives %ld\n", name, sum, expected);
+    std::abort();
+  }
+}
+
+bool check_all() {
+  long expected = folded();
+  expect_sum("blocks of 16", batched<16>(), expected);
+  expect_sum("blocks of 64", batched<64>(), expected);
+  expect_sum("blocks of 256", batched<256>(), expected);
+  expect_sum("blocks of 1024", batched<1024>(), expected);
+  expect_sum("blocks of 4096", batched<4096>(), expected);
+
+  auto boxed = FIter::Map([](int x) { return Boxed(x); })(v.begin(), v.end());
+  auto odd = FIter::Filter([](const Boxed& b) { return b.x % 2 != 0; })(boxed.begin(), boxed.end());
+  long sum = 0;
+  FIter::ForEachBatch<64>([&sum](Boxed* items, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i) sum += items[i].x;
+  })(odd);
+  expect_sum("of items which can't be default constructed", sum,
+    FIter::Fold(0L, [](long a, const Boxed& b) { return a + b.x; })(odd));
+  return true;
+}
+
+BENCH_CASE("batch map-filter-take", "Fold, one item at a time", N, [] {
+  static bool checked = check_all();
+  bench::keep(checked);
+  bench::keep(folded());
+});
+
+BENCH_CASE("batch map-filter-take", "blocks of 16", N, [] { bench::keep(batched<16>()); });
+BENCH_CASE("batch map-filter-take", "blocks of 64", N, [] { bench::keep(batched<64>()); });
+BENCH_CASE("batch map-filter-take", "blocks of 256", N, [] { bench::keep(batched<256>()); });
+BENCH_CASE("batch map-filter-take", "blocks of 1024", N, [] { bench::keep(batched<1024>()); });
+BENCH_CASE("batch map-filter-take", "blocks of 4096", N, [] { bench::keep(batched<4096>()); });
+
+}
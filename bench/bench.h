@@ -0,0 +1,87 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A deliberately tiny benchmark harness. Each case runs one pass over 'elements' items;
+// the harness repeats it until enough time has passed and reports the best pass, per
+// element. Cases are grouped: within a group, the first case registered is the baseline
+// (normally the hand-written loop) that the others are compared against, and the ratio to
+// it is the abstraction penalty. Heap allocations are counted over one untimed pass (see
+// main.cc, which replaces operator new).
+
+namespace bench {
+
+
+struct Case {
+  std::string group;
+  std::string name;
+  long elements;
+  std::function<void()> run;
+};
+
+inline std::vector<Case>& cases() {
+  static std::vector<Case> all;
+  return all;
+}
+
+// Registers a case at static-initialization time. Use through BENCH_CASE, below.
+struct Register {
+  Register(std::string group, std::string name, long elements, std::function<void()> run) {
+    Case c = {group, name, elements, run};
+    cases().push_back(c);
+  }
+};
+
+#define BENCH_CAT2(a, b) a##b
+#define BENCH_CAT(a, b) BENCH_CAT2(a, b)
+#define BENCH_CASE(group, name, elements, ...) \
+  static bench::Register BENCH_CAT(bench_case_, __LINE__)(group, name, elements, __VA_ARGS__)
+
+
+// Cases which count calls to their callables add to this; the harness reports it per
+// element, from a single untimed pass.
+inline long& calls() {
+  static long n = 0;
+  return n;
+}
+
+
+// Heap allocations so far, on any thread. Counted by main.cc's operator new.
+inline std::atomic<long>& allocations() {
+  static std::atomic<long> n(0);
+  return n;
+}
+
+
+// Keeps the optimizer from discarding a result it can prove is never used.
+template <class T>
+inline void keep(const T& value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+// Best time for one pass of 'run', in nanoseconds.
+inline double best_pass_ns(const std::function<void()>& run) {
+  typedef std::chrono::steady_clock clock;
+  run(); // warm up caches and the branch predictor
+  double best = 1e300;
+  auto started = clock::now();
+  for(int reps = 0; reps < 5 || clock::now() - started < std::chrono::milliseconds(200); ++reps) {
+    auto t0 = clock::now();
+    run();
+    auto t1 = clock::now();
+    best = std::min(best, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+  }
+  return best;
+}
+
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <vector>
+#include "bench.h"
+#include "../src/Cache.h"
+#include "../src/Filter.h"
+#include "../src/Map.h"
+#include "../src/TakeWhile.h"
+
+// A Filter then a TakeWhile after an expensive Map, with and without a Cache between them.
+// Without one, the Map runs for the Filter's test and again whenever a later stage looks
+// at an item the Filter passes on; with one, it should run exactly once per element. The
+// table cases walk the same 64 elements over and over, as a std algorithm copying
+// iterators around might; the last with std::max_element, over items which allocate, so
+// that copying an item with each iterator would show up as allocations.
+
+namespace {
+
+const long N = 1 << 14;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+long decode(int x) { // stands in for something like parsing a record
+  ++bench::calls();
+  long h = x;
+  for(int i = 0; i < 200; ++i)
+    h = h * 31 + (h >> 7);
+  return h;
+}
+bool keep_odd(long x) { return x & 1; }
+bool any(long) { return true; }
+
+BENCH_CASE("Filter and TakeWhile after an expensive Map", "hand-written loop", N, [] {
+  long sum = 0;
+  for(auto x : v) {
+    long d = decode(x);
+    if(keep_odd(d) && any(d)) sum += d;
+  }
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter and TakeWhile after an expensive Map", "no Cache", N, [] {
+  auto m = FIter::Map(decode)(v.begin(), v.end());
+  auto f = FIter::Filter(keep_odd)(m.begin(), m.end());
+  auto t = FIter::TakeWhile(any)(f.begin(), f.end());
+  long sum = 0;
+  for(auto x : t) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter and TakeWhile after an expensive Map", "Cache", N, [] {
+  auto m = FIter::Map(decode)(v.begin(), v.end());
+  auto c = FIter::Cache()(m.begin(), m.end());
+  auto f = FIter::Filter(keep_odd)(c.begin(), c.end());
+  auto t = FIter::TakeWhile(any)(f.begin(), f.end());
+  long sum = 0;
+  for(auto x : t) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("walking 64 elements of an expensive Map repeatedly", "no Cache", N, [] {
+  auto m = FIter::Map(decode)(v.begin(), v.begin() + 64);
+  long sum = 0;
+  for(long pass = 0; pass < N / 64; ++pass)
+    for(auto x : m) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("walking 64 elements of an expensive Map repeatedly", "Cache(64)", N, [] {
+  auto m = FIter::Map(decode)(v.begin(), v.begin() + 64);
+  auto c = FIter::Cache(64)(m.begin(), m.end());
+  long sum = 0;
+  for(long pass = 0; pass < N / 64; ++pass)
+    for(auto x : c) sum += x;
+  bench::keep(sum);
+});
+
+std::vector<long> decode_record(int x) { // an item which is costly to copy
+  return std::vector<long>(16, decode(x));
+}
+bool first_less(const std::vector<long>& a, const std::vector<long>& b) { return a[0] < b[0]; }
+
+BENCH_CASE("largest of 64 records of an expensive Map, repeatedly", "no Cache", N, [] {
+  auto m = FIter::Map(decode_record)(v.begin(), v.begin() + 64);
+  long sum = 0;
+  for(long pass = 0; pass < N / 64; ++pass)
+    sum += (*std::max_element(m.begin(), m.end(), first_less))[0];
+  bench::keep(sum);
+});
+
+BENCH_CASE("largest of 64 records of an expensive Map, repeatedly", "Cache(64)", N, [] {
+  auto m = FIter::Map(decode_record)(v.begin(), v.begin() + 64);
+  auto c = FIter::Cache(64)(m.begin(), m.end());
+  long sum = 0;
+  for(long pass = 0; pass < N / 64; ++pass)
+    sum += (*std::max_element(c.begin(), c.end(), first_less))[0];
+  bench::keep(sum);
+});
+
+}
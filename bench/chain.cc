@@ -0,0 +1,56 @@
+#include <vector>
+#include "bench.h"
+#include "../src/Chain.h"
+#include "../src/Fold.h"
+
+// Summing the same 1M items split into 1, 10 and 1000 segments, chained at run time from
+// a vector of vectors: with Fold, which loops over each segment on its own, the cost per
+// item shouldn't depend on the number of segments; range-for pays for a check against
+// the end of the segment per item, however many there are.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<std::vector<int>> split(long segments) {
+  std::vector<std::vector<int>> shards(segments);
+  for(long i = 0; i < N; ++i)
+    shards[i * segments / N].push_back((int)(i * 7 % 1000));
+  return shards;
+}
+std::vector<std::vector<int>> one = split(1), ten = split(10), thousand = split(1000);
+
+auto plus = [](long a, long b) { return a + b; };
+
+BENCH_CASE("sum over Chain of segments", "hand-written loops, 1000 segments", N, [] {
+  long sum = 0;
+  for(auto& shard : thousand)
+    for(auto x : shard) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum over Chain of segments", "Fold, 1 segment", N, [] {
+  bench::keep(FIter::Fold(0L, plus)(FIter::Chain(one)));
+});
+
+BENCH_CASE("sum over Chain of segments", "Fold, 10 segments", N, [] {
+  bench::keep(FIter::Fold(0L, plus)(FIter::Chain(ten)));
+});
+
+BENCH_CASE("sum over Chain of segments", "Fold, 1000 segments", N, [] {
+  bench::keep(FIter::Fold(0L, plus)(FIter::Chain(thousand)));
+});
+
+BENCH_CASE("sum over Chain of segments", "range-for, 1 segment", N, [] {
+  long sum = 0;
+  for(auto x : FIter::Chain(one)) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum over Chain of segments", "range-for, 1000 segments", N, [] {
+  long sum = 0;
+  for(auto x : FIter::Chain(thousand)) sum += x;
+  bench::keep(sum);
+});
+
+}
@@ -0,0 +1,59 @@
+#include <vector>
+#include "bench.h"
+#include "../src/Collect.h"
+#include "../src/Map.h"
+#include "../src/Progression.h"
+#include "../src/Take.h"
+
+// Materialising a Map -> Take pipeline into a vector. Pushing back without reserving
+// reallocates and copies about log2(n) times; Collect knows the size and reserves once,
+// which should bring it close to the loop over a presized vector.
+
+namespace {
+
+const long N = 1 << 22;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)i;
+  return v;
+}
+std::vector<int> v = input();
+
+BENCH_CASE("collect map-take", "presized loop", N, [] {
+  std::vector<long> out(N - 1);
+  for(long i = 0; i < N - 1; ++i) out[i] = v[i] * 3L;
+  bench::keep(out.back());
+});
+
+BENCH_CASE("collect map-take", "push_back, no reserve", N, [] {
+  auto m = FIter::Map([](int x) { return x * 3L; })(v.begin(), v.end());
+  auto t = FIter::Take(N - 1)(m.begin(), m.end());
+  std::vector<long> out;
+  for(auto x : t) out.push_back(x);
+  bench::keep(out.back());
+});
+
+BENCH_CASE("collect map-take", "Collect", N, [] {
+  auto m = FIter::Map([](int x) { return x * 3L; })(v.begin(), v.end());
+  auto t = FIter::Take(N - 1)(m.begin(), m.end());
+  auto out = FIter::Collect<std::vector<long>>()(t);
+  bench::keep(out.back());
+});
+
+BENCH_CASE("collect take-progression", "push_back, no reserve", N, [] {
+  auto p = FIter::Progression(0L, 3L);
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  std::vector<long> out;
+  for(auto x : t) out.push_back(x);
+  bench::keep(out.back());
+});
+
+BENCH_CASE("collect take-progression", "Collect", N, [] {
+  auto p = FIter::Progression(0L, 3L);
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  auto out = FIter::Collect<std::vector<long>>()(t);
+  bench::keep(out.back());
+});
+
+}
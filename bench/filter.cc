@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+#include "bench.h"
+#include "../src/Filter.h"
+
+// Filter with a predicate that counts its calls. However the filtered range is walked
+// (range-for, postfix increments, or a std algorithm copying iterators around), each
+// element should be tested exactly once: each case checks that it was, N times exactly,
+// and the program stops if not.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+bool counted_mod3(int x) {
+  ++bench::calls();
+  return x % 3 == 0;
+}
+
+void expect_calls(const char* name, long before) {
+  long n = bench::calls() - before;
+  if(n != N) {
+    std::fprintf(stderr, "Filter with %s called its predicate %ld times over %ld elements\n", name, n, N);
+    std::abort();
+  }
+}
+
+BENCH_CASE("filter predicate calls", "hand-written loop", N, [] {
+  long before = bench::calls();
+  long sum = 0;
+  for(auto x : v)
+    if(counted_mod3(x)) sum += x;
+  bench::keep(sum);
+  expect_calls("a hand-written loop", before);
+});
+
+BENCH_CASE("filter predicate calls", "range-for", N, [] {
+  long before = bench::calls();
+  auto f = FIter::Filter(counted_mod3)(v.begin(), v.end());
+  long sum = 0;
+  for(auto x : f) sum += x;
+  bench::keep(sum);
+  expect_calls("range-for", before);
+});
+
+BENCH_CASE("filter predicate calls", "postfix increment", N, [] {
+  long before = bench::calls();
+  auto f = FIter::Filter(counted_mod3)(v.begin(), v.end());
+  long sum = 0;
+  auto end = f.end();
+  for(auto it = f.begin(); it != end; it++) sum += *it;
+  bench::keep(sum);
+  expect_calls("postfix increments", before);
+});
+
+BENCH_CASE("filter predicate calls", "std::accumulate", N, [] {
+  long before = bench::calls();
+  auto f = FIter::Filter(counted_mod3)(v.begin(), v.end());
+  long sum = std::accumulate(f.begin(), f.end(), 0L);
+  bench::keep(sum);
+  expect_calls("std::accumulate", before);
+});
+
+}
@@ -0,0 +1,104 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+#include "bench.h"
+#include "../src/Collect.h"
+#include "../src/Filter.h"
+#include "../src/Fold.h"
+#include "../src/Lines.h"
+
+// Counting the lines of a 64MB log containing 'ERROR', with std::getline against
+// LineReader. Elements are bytes, so 1 / (ns/element) is the throughput in GB/s. The file
+// stays in the page cache throughout, so this is the cost of splitting lines, not of the
+// disk.
+//
+// Before the first LineReader case is timed, the lines LineReader collects (which come in
+// blocks: see _for_each_batch in FIter.h) are checked against std::getline's, reading in
+// blocks of two sizes, and the program stops if they differ.
+
+namespace {
+
+const long lines = 1 << 20;
+
+// A temporary log file, removed at exit.
+struct TempLog {
+  std::string path;
+  long bytes;
+
+  TempLog() : bytes(0) {
+    char name[] = "/tmp/fiter-bench-XXXXXX";
+    int fd = mkstemp(name);
+    if(fd < 0) { std::perror("mkstemp"); std::exit(1); }
+    path = name;
+    std::string text;
+    for(long i = 0; i < lines; ++i) {
+      text += "2024-01-01T00:00:00 host-" + std::to_string(i % 97) + (i % 13 == 0 ? " ERROR " : " INFO ");
+      text.append(i * 7 % 40, 'x');
+      text += " request " + std::to_string(i) + '\n';
+    }
+    if(write(fd, text.data(), text.size()) != (ssize_t)text.size()) { std::perror("write"); std::exit(1); }
+    close(fd);
+    bytes = text.size();
+  }
+
+  ~TempLog() { unlink(path.c_str()); }
+};
+TempLog log_file;
+
+void check(std::size_t block) {
+  std::ifstream in(log_file.path);
+  std::vector<std::string> expected;
+  for(std::string line; std::getline(in, line); )
+    expected.push_back(line);
+  FIter::LineReader reader(log_file.path, '\n', block);
+  if(FIter::Collect<std::vector<std::string>>()(reader) != expected) {
+    std::fprintf(stderr, "lines collected from LineReader with %zu byte blocks differ from std::getline's\n", block);
+    std::abort();
+  }
+}
+
+bool check_all() {
+  check(FIter::LineReader::default_block);
+  check(4096); // the smallest there is: a page
+  return true;
+}
+
+bool is_error(std::string_view line) { return line.find("ERROR") != line.npos; }
+auto count = [](long n, std::string_view) { return n + 1; };
+
+BENCH_CASE("lines with ERROR in a 64MB log", "std::getline", log_file.bytes, [] {
+  std::ifstream in(log_file.path);
+  std::string line;
+  long n = 0;
+  while(std::getline(in, line))
+    if(is_error(line)) ++n;
+  bench::keep(n);
+});
+
+BENCH_CASE("lines with ERROR in a 64MB log", "LineReader + Filter", log_file.bytes, [] {
+  static bool checked = check_all();
+  bench::keep(checked);
+  FIter::LineReader in(log_file.path);
+  auto errors = FIter::Filter(is_error)(in.begin(), in.end());
+  bench::keep(FIter::Fold(0L, count)(errors));
+});
+
+BENCH_CASE("all lines of a 64MB log", "std::getline", log_file.bytes, [] {
+  std::ifstream in(log_file.path);
+  std::string line;
+  long n = 0;
+  while(std::getline(in, line)) ++n;
+  bench::keep(n);
+});
+
+BENCH_CASE("all lines of a 64MB log", "LineReader", log_file.bytes, [] {
+  FIter::LineReader in(log_file.path);
+  bench::keep(FIter::Fold(0L, count)(in));
+});
+
+}
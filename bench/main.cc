@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "bench.h"
+
+// Every allocation goes through here, so that cases can be checked for allocating per
+// element (or at all). The aligned and sized forms all end up in these.
+void* operator new(std::size_t n) {
+  ++bench::allocations();
+  if(void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+void* operator new(std::size_t n, std::align_val_t a) {
+  ++bench::allocations();
+  std::size_t align = (std::size_t)a;
+  if(void* p = std::aligned_alloc(align, (n + align - 1) / align * align)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t n, std::align_val_t a) { return operator new(n, a); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+
+// Writes s as a JSON string.
+static void json_string(const std::string& s) {
+  std::putchar('"');
+  for(char c : s) {
+    if(c == '"' || c == '\\') std::printf("\\%c", c);
+    else if((unsigned char)c < 0x20) std::printf("\\u%04x", c);
+    else std::putchar(c);
+  }
+  std::putchar('"');
+}
+
+// Runs every registered case, or only those whose group contains the last argument.
+// With --json, prints an array of results, one object per case, for comparing runs
+// across versions; otherwise a table.
+int main(int argc, char** argv) {
+  bool json = false;
+  const char* only = "";
+  for(int i = 1; i < argc; ++i) {
+    if(std::strcmp(argv[i], "--json") == 0) json = true;
+    else only = argv[i];
+  }
+  std::string group;
+  double baseline = 0;
+  bool first = true;
+
+  if(json) std::printf("[");
+  for(auto& c : bench::cases()) {
+    if(c.group.find(only) == std::string::npos) continue;
+    double ns = bench::best_pass_ns(c.run) / c.elements;
+    bool is_baseline = (group != c.group); // first case of a group is its baseline
+    if(is_baseline) {
+      group = c.group;
+      baseline = ns;
+      if(!json) std::printf("\n%s\n", group.c_str());
+    }
+
+    bench::calls() = 0;
+    long allocated = bench::allocations();
+    c.run();
+    allocated = bench::allocations() - allocated;
+    double calls = (double)bench::calls() / c.elements;
+
+    if(json) {
+      std::printf("%s\n  {\"group\": ", first ? "" : ",");
+      json_string(c.group);
+      std::printf(", \"name\": ");
+      json_string(c.name);
+      std::printf(", \"baseline\": %s, \"elements\": %ld, \"ns_per_element\": %.4f, \"ratio\": %.4f, \"allocations\": %ld",
+        is_baseline ? "true" : "false", c.elements, ns, ns / baseline, allocated);
+      if(bench::calls())
+        std::printf(", \"calls_per_element\": %.4f", calls);
+      std::printf("}");
+      first = false;
+    }
+    else {
+      std::printf("  %-40s %8.3f ns/element  %6.2fx  %6ld allocs", c.name.c_str(), ns, ns / baseline, allocated);
+      if(bench::calls())
+        std::printf("  %6.3f calls/element", calls);
+      std::printf("\n");
+    }
+    std::fflush(stdout);
+  }
+  if(json) std::printf("\n]\n");
+  return 0;
+}
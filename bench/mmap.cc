@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "bench.h"
+#include "../src/Filter.h"
+#include "../src/Fold.h"
+#include "../src/Map.h"
+#include "../src/Mmap.h"
+
+// Summing the prices of the records passing a filter, from a 64MB file of records, read
+// into a vector first against mapped with MmapRange. Each pass includes getting at the
+// file, since that's what the vector pays for, and the file stays in the page cache
+// throughout, so neither pays for the disk.
+
+namespace {
+
+struct Trade {
+  std::int64_t id;
+  double price;
+};
+
+const long N = 1 << 22;
+
+// A temporary file of N records, removed at exit.
+struct TempFile {
+  std::string path;
+
+  TempFile() {
+    char name[] = "/tmp/fiter-bench-XXXXXX";
+    int fd = mkstemp(name);
+    if(fd < 0) { std::perror("mkstemp"); std::exit(1); }
+    path = name;
+    std::vector<Trade> trades(N);
+    for(long i = 0; i < N; ++i) trades[i] = Trade{i, (double)(i * 7 % 1000)};
+    if(write(fd, trades.data(), N * sizeof(Trade)) != (ssize_t)(N * sizeof(Trade))) { std::perror("write"); std::exit(1); }
+    close(fd);
+  }
+
+  ~TempFile() { unlink(path.c_str()); }
+};
+TempFile file;
+
+auto odd = [](const Trade& t) { return (t.id & 1) != 0; };
+auto price = [](const Trade& t) { return t.price; };
+auto plus = [](double a, double b) { return a + b; };
+
+template <class Range>
+double sum_of_odd(const Range& trades) {
+  auto f = FIter::Filter(odd)(trades.begin(), trades.end());
+  auto m = FIter::Map(price)(f.begin(), f.end());
+  return FIter::Fold(0.0, plus)(m);
+}
+
+BENCH_CASE("sum over a 64MB file of records", "read into vector", N, [] {
+  std::vector<Trade> trades(N);
+  FILE* in = std::fopen(file.path.c_str(), "rb");
+  bench::keep(std::fread(trades.data(), sizeof(Trade), N, in));
+  std::fclose(in);
+  bench::keep(sum_of_odd(trades));
+});
+
+BENCH_CASE("sum over a 64MB file of records", "MmapRange", N, [] {
+  FIter::MmapRange<Trade> trades(file.path);
+  bench::keep(sum_of_odd(trades));
+});
+
+}
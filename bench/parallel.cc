@@ -0,0 +1,186 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+#include "bench.h"
+#include "../src/Collect.h"
+#include "../src/Filter.h"
+#include "../src/Map.h"
+#include "../src/Parallel.h"
+#include "../src/Progression.h"
+#include "../src/Take.h"
+
+// Summing a Map in parallel on pools of 1 to 8 threads, against Fold. The Progression
+// case computes its items, so it should scale with cores; the vector case reads memory,
+// and stops scaling when that runs out of bandwidth. (Run the whole sum over 10^9 items
+// by raising N; the per-item figures don't change much.) Before the first is timed, the
+// program stops unless each pool's sum is Fold's, and unless a TaskGroup whose spawn()
+// throws (here, copying the task) still waits for, and then ends, its other tasks.
+//
+// Then collecting a Filter of a Map and a Map of a Filter in parallel, against Collect.
+// Before the first case of each of those groups is timed (so only when it is run), its
+// parallel collect is checked against Collect's result for every pool size, and the
+// program stops if they differ.
+
+namespace {
+
+const long N = 1 << 24;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+auto square = [](long x) { return x * x % 1009; };
+auto plus = [](long a, long b) { return a + b; };
+
+template <std::size_t Threads>
+FIter::ThreadPool& pool() {
+  static FIter::ThreadPool p(Threads);
+  return p;
+}
+
+template <std::size_t Threads>
+void progression() {
+  auto p = FIter::Progression();
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  auto m = FIter::Map(square)(t.begin(), t.end());
+  bench::keep(FIter::ParallelFold(0L, plus, plus, pool<Threads>())(m));
+}
+
+template <std::size_t Threads>
+void vector() {
+  auto m = FIter::Map(square)(v.begin(), v.end());
+  bench::keep(FIter::ParallelFold(0L, plus, plus, pool<Threads>())(m));
+}
+
+// Throws when copied for the second time: spawn() takes a copy, and copies that into the
+// task it queues.
+struct Throws_when_copied {
+  int* copies;
+  explicit Throws_when_copied(int* _copies) : copies(_copies) {}
+  Throws_when_copied(const Throws_when_copied& r) : copies(r.copies) {
+    if(++*copies == 2) throw std::runtime_error("copied");
+  }
+  void operator()() const {}
+};
+
+template <std::size_t Threads>
+bool check_sum() {
+  auto p = FIter::Progression();
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  auto m = FIter::Map(square)(t.begin(), t.end());
+  if(FIter::ParallelFold(0L, plus, plus, pool<Threads>())(m) != FIter::Fold(0L, plus)(m)) {
+    std::fprintf(stderr, "parallel sum on %zu threads differs from Fold\n", Threads);
+    std::abort();
+  }
+
+  if(Threads == 1) return true; // nothing is queued
+  int copies = 0;
+  bool threw = false;
+  try {
+    FIter::TaskGroup g(pool<Threads>());
+    Throws_when_copied f(&copies);
+    g.spawn(std::ref(f)); // queued, but not copied
+    g.spawn(f);
+    g.wait();
+  }
+  catch(const std::runtime_error&) {
+    threw = true;
+  }
+  if(!threw) {
+    std::fprintf(stderr, "a throwing spawn() on %zu threads didn't throw\n", Threads);
+    std::abort();
+  }
+  return true;
+}
+
+bool check_sums() {
+  return check_sum<1>() && check_sum<2>() && check_sum<4>() && check_sum<8>();
+}
+
+BENCH_CASE("parallel sum of Map over Take(Progression)", "Fold", N, [] {
+  static bool checked = check_sums();
+  bench::keep(checked);
+  auto p = FIter::Progression();
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  auto m = FIter::Map(square)(t.begin(), t.end());
+  bench::keep(FIter::Fold(0L, plus)(m));
+});
+BENCH_CASE("parallel sum of Map over Take(Progression)", "1 thread", N, progression<1>);
+BENCH_CASE("parallel sum of Map over Take(Progression)", "2 threads", N, progression<2>);
+BENCH_CASE("parallel sum of Map over Take(Progression)", "4 threads", N, progression<4>);
+BENCH_CASE("parallel sum of Map over Take(Progression)", "8 threads", N, progression<8>);
+
+BENCH_CASE("parallel sum of Map over vector", "Fold", N, [] {
+  auto m = FIter::Map(square)(v.begin(), v.end());
+  bench::keep(FIter::Fold(0L, plus)(m));
+});
+BENCH_CASE("parallel sum of Map over vector", "1 thread", N, vector<1>);
+BENCH_CASE("parallel sum of Map over vector", "2 threads", N, vector<2>);
+BENCH_CASE("parallel sum of Map over vector", "4 threads", N, vector<4>);
+BENCH_CASE("parallel sum of Map over vector", "8 threads", N, vector<8>);
+
+
+auto keep_third = [](long x) { return x % 3 == 0; };
+
+auto filter_of_map() {
+  auto m = FIter::Map(square)(v.begin(), v.end());
+  return FIter::Filter(keep_third)(m.begin(), m.end());
+}
+auto map_of_filter() {
+  auto f = FIter::Filter(keep_third)(v.begin(), v.end());
+  return FIter::Map(square)(f.begin(), f.end());
+}
+
+template <std::size_t Threads, class Pipeline>
+void check(const char* name, Pipeline p) {
+  if(FIter::ParallelCollect<std::vector<long>>(pool<Threads>())(p()) != FIter::Collect<std::vector<long>>()(p())) {
+    std::fprintf(stderr, "parallel collect of %s on %zu threads differs from Collect\n", name, Threads);
+    std::abort();
+  }
+}
+
+template <class Pipeline>
+bool check_all(const char* name, Pipeline p) {
+  check<1>(name, p);
+  check<2>(name, p);
+  check<4>(name, p);
+  check<8>(name, p);
+  return true;
+}
+
+template <std::size_t Threads>
+void collect_filter_of_map() {
+  bench::keep(FIter::ParallelCollect<std::vector<long>>(pool<Threads>())(filter_of_map()));
+}
+
+template <std::size_t Threads>
+void collect_map_of_filter() {
+  bench::keep(FIter::ParallelCollect<std::vector<long>>(pool<Threads>())(map_of_filter()));
+}
+
+BENCH_CASE("parallel collect of Filter of Map over vector", "Collect", N, [] {
+  static bool checked = check_all("Filter of Map", filter_of_map);
+  bench::keep(checked);
+  bench::keep(FIter::Collect<std::vector<long>>()(filter_of_map()));
+});
+BENCH_CASE("parallel collect of Filter of Map over vector", "1 thread", N, collect_filter_of_map<1>);
+BENCH_CASE("parallel collect of Filter of Map over vector", "2 threads", N, collect_filter_of_map<2>);
+BENCH_CASE("parallel collect of Filter of Map over vector", "4 threads", N, collect_filter_of_map<4>);
+BENCH_CASE("parallel collect of Filter of Map over vector", "8 threads", N, collect_filter_of_map<8>);
+
+BENCH_CASE("parallel collect of Map of Filter over vector", "Collect", N, [] {
+  static bool checked = check_all("Map of Filter", map_of_filter);
+  bench::keep(checked);
+  bench::keep(FIter::Collect<std::vector<long>>()(map_of_filter()));
+});
+BENCH_CASE("parallel collect of Map of Filter over vector", "1 thread", N, collect_map_of_filter<1>);
+BENCH_CASE("parallel collect of Map of Filter over vector", "2 threads", N, collect_map_of_filter<2>);
+BENCH_CASE("parallel collect of Map of Filter over vector", "4 threads", N, collect_map_of_filter<4>);
+BENCH_CASE("parallel collect of Map of Filter over vector", "8 threads", N, collect_map_of_filter<8>);
+
+}
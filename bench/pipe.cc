@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include "bench.h"
+#include "../src/Collect.h"
+#include "../src/Fold.h"
+#include "../src/Pipe.h"
+
+// Chains of the same stage, nested by hand and written with '|' (which fuses them: see
+// Pipe.h), at depths 1, 2 and 4, against the loop one would write instead. Nested, each
+// level adds a loop and an end check per item; piped, the depth should hardly matter.
+// Walked with range-for, and with Fold, which pushes (see _for_each in FIter.h).
+//
+// The predicates each pass almost everything, so that every level sees every item.
+//
+// Before the first case is timed, each piped chain (and the Take and Drop fusions, which
+// aren't timed) is checked to give the same items as its nested form, and the program
+// stops if they differ.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+auto not1 = [](int x) { return x != 1; };
+auto not2 = [](int x) { return x != 2; };
+auto not3 = [](int x) { return x != 3; };
+auto not4 = [](int x) { return x != 4; };
+auto inc = [](int x) { return x + 1; };
+auto odd = [](int x) { return x % 2 != 0; };
+
+template <class R>
+long walk(const R& r) {
+  long sum = 0;
+  for(auto x : r) sum += x;
+  return sum;
+}
+
+template <class R>
+long fold(const R& r) {
+  return FIter::Fold(0L, std::plus<long>())(r);
+}
+
+auto filter_x2_nested() {
+  auto f1 = FIter::Filter(not1)(v.begin(), v.end());
+  return FIter::Filter(not2)(f1.begin(), f1.end());
+}
+auto filter_x2_piped() {
+  return v | FIter::Filter(not1) | FIter::Filter(not2);
+}
+
+auto filter_x4_nested() {
+  auto f1 = FIter::Filter(not1)(v.begin(), v.end());
+  auto f2 = FIter::Filter(not2)(f1.begin(), f1.end());
+  auto f3 = FIter::Filter(not3)(f2.begin(), f2.end());
+  return FIter::Filter(not4)(f3.begin(), f3.end());
+}
+auto filter_x4_piped() {
+  return v | FIter::Filter(not1) | FIter::Filter(not2) | FIter::Filter(not3) | FIter::Filter(not4);
+}
+
+auto map_x4_nested() {
+  auto m1 = FIter::Map(inc)(v.begin(), v.end());
+  auto m2 = FIter::Map(inc)(m1.begin(), m1.end());
+  auto m3 = FIter::Map(inc)(m2.begin(), m2.end());
+  return FIter::Map(inc)(m3.begin(), m3.end());
+}
+auto map_x4_piped() {
+  return v | FIter::Map(inc) | FIter::Map(inc) | FIter::Map(inc) | FIter::Map(inc);
+}
+
+auto map_filter_nested() {
+  auto m = FIter::Map(inc)(v.begin(), v.end());
+  return FIter::Filter(odd)(m.begin(), m.end());
+}
+auto map_filter_piped() {
+  return v | FIter::Map(inc) | FIter::Filter(odd);
+}
+
+template <class Nested, class Piped>
+void check(const char* name, const Nested& nested, const Piped& piped) {
+  if(FIter::Collect<std::vector<int>>()(piped) != FIter::Collect<std::vector<int>>()(nested)) {
+    std::fprintf(stderr, "piped %s gives different items from the nested stages\n", name);
+    std::abort();
+  }
+}
+
+bool check_all() {
+  check("Filter x1", FIter::Filter(not1)(v.begin(), v.end()), v | FIter::Filter(not1));
+  check("Filter x2", filter_x2_nested(), filter_x2_piped());
+  check("Filter x4", filter_x4_nested(), filter_x4_piped());
+  check("Map x4", map_x4_nested(), map_x4_piped());
+  check("Map then Filter", map_filter_nested(), map_filter_piped());
+  auto mf = map_filter_nested();
+  check("Map then Filter then Filter", FIter::Filter(not4)(mf.begin(), mf.end()), map_filter_piped() | FIter::Filter(not4));
+  auto t = FIter::Take(1000)(v.begin(), v.end());
+  check("Take then Take", FIter::Take(10)(t.begin(), t.end()), v | FIter::Take(1000) | FIter::Take(10));
+  auto d = FIter::Drop(1000)(v.begin(), v.end());
+  check("Drop then Drop", FIter::Drop(10)(d.begin(), d.end()), v | FIter::Drop(1000) | FIter::Drop(10));
+  return true;
+}
+
+
+BENCH_CASE("Filter x1", "hand-written loop", N, [] {
+  static bool checked = check_all();
+  bench::keep(checked);
+  long sum = 0;
+  for(auto x : v)
+    if(not1(x)) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter x1", "nested", N, [] {
+  bench::keep(walk(FIter::Filter(not1)(v.begin(), v.end())));
+});
+
+BENCH_CASE("Filter x1", "piped", N, [] {
+  bench::keep(walk(v | FIter::Filter(not1)));
+});
+
+
+BENCH_CASE("Filter x2", "hand-written loop", N, [] {
+  long sum = 0;
+  for(auto x : v)
+    if(not1(x) && not2(x)) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter x2", "nested", N, [] {
+  bench::keep(walk(filter_x2_nested()));
+});
+
+BENCH_CASE("Filter x2", "piped", N, [] {
+  bench::keep(walk(filter_x2_piped()));
+});
+
+
+BENCH_CASE("Filter x4", "hand-written loop", N, [] {
+  long sum = 0;
+  for(auto x : v)
+    if(not1(x) && not2(x) && not3(x) && not4(x)) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter x4", "nested", N, [] {
+  bench::keep(walk(filter_x4_nested()));
+});
+
+BENCH_CASE("Filter x4", "piped", N, [] {
+  bench::keep(walk(filter_x4_piped()));
+});
+
+BENCH_CASE("Filter x4", "nested, Fold", N, [] {
+  bench::keep(fold(filter_x4_nested()));
+});
+
+BENCH_CASE("Filter x4", "piped, Fold", N, [] {
+  bench::keep(fold(filter_x4_piped()));
+});
+
+
+BENCH_CASE("Map x4", "hand-written loop", N, [] {
+  long sum = 0;
+  for(auto x : v) sum += inc(inc(inc(inc(x))));
+  bench::keep(sum);
+});
+
+BENCH_CASE("Map x4", "nested", N, [] {
+  bench::keep(walk(map_x4_nested()));
+});
+
+BENCH_CASE("Map x4", "piped", N, [] {
+  bench::keep(walk(map_x4_piped()));
+});
+
+
+// A Filter over a Map calls the map again for each item it lets through; piped, they
+// become a MapFilter, which calls it once.
+BENCH_CASE("Map then Filter", "hand-written loop", N, [] {
+  long sum = 0;
+  for(auto x : v) {
+    int y = inc(x);
+    if(odd(y)) sum += y;
+  }
+  bench::keep(sum);
+});
+
+BENCH_CASE("Map then Filter", "nested", N, [] {
+  bench::keep(walk(map_filter_nested()));
+});
+
+BENCH_CASE("Map then Filter", "piped", N, [] {
+  bench::keep(walk(map_filter_piped()));
+});
+
+}
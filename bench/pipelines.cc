@@ -0,0 +1,78 @@
+#include <functional>
+#include <vector>
+#include "bench.h"
+#include "../src/Map.h"
+#include "../src/Filter.h"
+#include "../src/Take.h"
+#include "../src/Progression.h"
+
+// Map -> Filter -> Take over a vector, against the loop one would write by hand. The
+// std::function case erases the same lambdas, which is what the stages used to do
+// internally.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+BENCH_CASE("map-filter-take", "hand-written loop", N, [] {
+  long sum = 0, taken = 0;
+  for(auto it = v.begin(); it != v.end() && taken < N / 4; ++it) {
+    int x = *it * 3 + 1;
+    if(x % 2 == 0) { sum += x; ++taken; }
+  }
+  bench::keep(sum);
+});
+
+BENCH_CASE("map-filter-take", "lambdas", N, [] {
+  auto m = FIter::Map([](int x) { return x * 3 + 1; })(v.begin(), v.end());
+  auto f = FIter::Filter([](int x) { return x % 2 == 0; })(m.begin(), m.end());
+  auto t = FIter::Take(N / 4)(f.begin(), f.end());
+  long sum = 0;
+  for(auto x : t) sum += x;
+  bench::keep(sum);
+});
+
+std::function<int(int)> mapf = [](int x) { return x * 3 + 1; };
+std::function<bool(int)> filterf = [](int x) { return x % 2 == 0; };
+
+BENCH_CASE("map-filter-take", "std::function", N, [] {
+  auto m = FIter::Map(mapf)(v.begin(), v.end());
+  auto f = FIter::Filter(filterf)(m.begin(), m.end());
+  auto t = FIter::Take(N / 4)(f.begin(), f.end());
+  long sum = 0;
+  for(auto x : t) sum += x;
+  bench::keep(sum);
+});
+
+}
+
+
+// Take over an infinite Progression, writing out each item. The Progression's end is
+// Unreachable, so the only exit test left in the loop should be Take's count.
+
+namespace {
+
+std::vector<long> out(N);
+
+BENCH_CASE("take-progression", "hand-written loop", N, [] {
+  long x = 5;
+  for(long i = 0; i < N; ++i, x += 3) out[i] = x;
+  bench::keep(out[N / 2]);
+});
+
+BENCH_CASE("take-progression", "Take(Progression)", N, [] {
+  auto p = FIter::Progression(5L, 3L);
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  long i = 0;
+  for(auto x : t) out[i++] = x;
+  bench::keep(out[N / 2]);
+});
+
+}
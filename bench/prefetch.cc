@@ -0,0 +1,105 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../src/Fold.h"
+#include "../src/Map.h"
+#include "../src/Prefetch.h"
+#include "../src/Progression.h"
+#include "../src/Take.h"
+
+// Throughput: an expensive Map upstream and an expensive fold downstream, run one after the
+// other, against overlapped through a Prefetch (which should approach the cost of the
+// slower of the two, given two cores, and pays for handing items over otherwise). And the
+// handover on its own, summing a vector.
+//
+// Latency: starting a Prefetch, getting its first item out, and shutting it down, with an
+// endless upstream (so the producer has to be stopped), per operation. Before the first
+// is timed, the program stops unless a producer told to stop goes on for at most a batch
+// (a quarter of the buffer) more items, rather than until the buffer is full.
+
+namespace {
+
+const long N = 1 << 16;
+
+long work(long x) {
+  for(int i = 0; i < 100; ++i)
+    x = x * 31 + (x >> 7);
+  return x;
+}
+auto decode = [](long x) { return work(x); };
+auto aggregate = [](long a, long x) { return a + work(x); };
+auto plus = [](long a, long x) { return a + x; };
+
+BENCH_CASE("expensive Map, then expensive Fold", "directly", N, [] {
+  auto p = FIter::Progression();
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  auto m = FIter::Map(decode)(t.begin(), t.end());
+  bench::keep(FIter::Fold(0L, aggregate)(m));
+});
+
+BENCH_CASE("expensive Map, then expensive Fold", "through Prefetch()", N, [] {
+  auto p = FIter::Progression();
+  auto t = FIter::Take(N)(p.begin(), p.end());
+  auto m = FIter::Map(decode)(t.begin(), t.end());
+  auto ahead = FIter::Prefetch()(m.begin(), m.end());
+  bench::keep(FIter::Fold(0L, aggregate)(ahead));
+});
+
+std::vector<long> input() {
+  std::vector<long> v(N);
+  for(long i = 0; i < N; ++i) v[i] = i * 7 % 1000;
+  return v;
+}
+std::vector<long> v = input();
+
+BENCH_CASE("sum of a vector", "directly", N, [] {
+  bench::keep(FIter::Fold(0L, plus)(v));
+});
+
+BENCH_CASE("sum of a vector", "through Prefetch()", N, [] {
+  auto ahead = FIter::Prefetch()(v.begin(), v.end());
+  bench::keep(FIter::Fold(0L, plus)(ahead));
+});
+
+// Counts the items made upstream. The producer is held at the 300th (after publishing the
+// first batch of 256, so that the consumer can take its items) until the consumer is done,
+// and each item after that is expensive, so that the consumer has stopped the producer
+// long before it could fill the buffer.
+std::atomic<long> made(0);
+std::atomic<bool> taken(false);
+auto counted = [](long x) {
+  if(++made == 300)
+    while(!taken.load()) std::this_thread::yield();
+  return work(x);
+};
+
+bool check_stop() {
+  {
+    auto p = FIter::Progression();
+    auto m = FIter::Map(counted)(p.begin(), p.end());
+    auto ahead = FIter::Prefetch(1024)(m.begin(), m.end());
+    auto t = FIter::Take(5)(ahead.begin(), ahead.end());
+    long sum = 0;
+    for(auto x : t) sum += x;
+    bench::keep(sum);
+    taken.store(true);
+  }
+  if(made.load() > 2 * 256) {
+    std::fprintf(stderr, "a stopped Prefetch(1024) went on to make %ld items\n", made.load());
+    std::abort();
+  }
+  return true;
+}
+
+BENCH_CASE("first item of a Prefetch, then stopping it", "Prefetch(1024)", 1, [] {
+  static bool checked = check_stop();
+  bench::keep(checked);
+  auto p = FIter::Progression();
+  auto ahead = FIter::Prefetch(1024)(p.begin(), p.end());
+  bench::keep(*ahead.begin());
+});
+
+}
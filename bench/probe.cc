@@ -0,0 +1,171 @@
+// Probes are compiled in for this file only (no other includes Probe.h), to measure what
+// they cost when on. Compiled out, Probe(name) and Probe(name, f) give back exactly what
+// they were given, so there is nothing to measure.
+#define FITER_PROBES
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "../src/Filter.h"
+#include "../src/Fold.h"
+#include "../src/Map.h"
+#include "../src/Probe.h"
+
+// A Filter then a Map over a vector, walked with range-for and with Fold (which pushes),
+// with and without a probe on every stage and callable.
+//
+// Before the first case is timed, the probed pipeline is run once each way, and the
+// program stops unless probe_report() has every probe's items, calls and passes exactly,
+// and the tree the pipeline's shape, and unless print_probes() and print_probes_json() say
+// so too. So does a probe straight over the vector, walked with range-for, unless it
+// reports next to no time of its own in the best of a few runs (incrementing a vector's iterator costs well under a
+// nanosecond, so all it could report is the clock's).
+
+namespace {
+
+const long N = 1 << 16;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+auto small = [](int x) { return x < 500; };
+auto square = [](int x) { return (long)x * x; };
+
+long probed_for() {
+  auto p = FIter::Probe("source")(v.begin(), v.end());
+  auto f = FIter::Filter(FIter::Probe("small", small))(p.begin(), p.end());
+  auto m = FIter::Map(FIter::Probe("square", square))(f.begin(), f.end());
+  auto q = FIter::Probe("squares")(m.begin(), m.end());
+  long sum = 0;
+  for(auto x : q) sum += x;
+  return sum;
+}
+
+long probed_fold() {
+  auto p = FIter::Probe("source")(v.begin(), v.end());
+  auto f = FIter::Filter(FIter::Probe("small", small))(p.begin(), p.end());
+  auto m = FIter::Map(FIter::Probe("square", square))(f.begin(), f.end());
+  auto q = FIter::Probe("squares")(m.begin(), m.end());
+  return FIter::Fold(0L, std::plus<long>())(q.begin(), q.end());
+}
+
+void expect(bool ok, const char* how, const char* what) {
+  if(!ok) {
+    std::fprintf(stderr, "probes, %s: %s\n", how, what);
+    std::abort();
+  }
+}
+
+void expect_text(const std::string& text, const std::string& part, const char* how) {
+  if(text.find(part) == std::string::npos) {
+    std::fprintf(stderr, "probes, %s: no '%s' in\n%s", how, part.c_str(), text.c_str());
+    std::abort();
+  }
+}
+
+// Every item is passed on by the source, and tried by small (once: the Filter's own
+// iterator tries the first, and those it gives copies of carry on from there); those it
+// passes are squared, and passed on.
+void check_report(const char* how) {
+  long passed = 0;
+  for(auto x : v) passed += small(x);
+
+  std::vector<FIter::ProbeReport> roots = FIter::probe_report();
+  expect(roots.size() == 1 && roots[0].name == "squares", how, "the only root isn't 'squares'");
+  const FIter::ProbeReport& r = roots[0];
+  expect(r.items == passed && r.items_in == N && !r.is_callable, how, "'squares' has the wrong counts");
+  expect(r.children.size() == 3, how, "'squares' hasn't 3 children");
+  const FIter::ProbeReport& sq = r.children[0];
+  const FIter::ProbeReport& sm = r.children[1];
+  const FIter::ProbeReport& src = r.children[2];
+  expect(sq.name == "square" && sq.is_callable && sq.items == passed && sq.passed == -1 && sq.children.empty(), how, "'square' is wrong");
+  expect(sm.name == "small" && sm.is_callable && sm.items == N && sm.passed == passed && sm.children.empty(), how, "'small' is wrong");
+  expect(src.name == "source" && !src.is_callable && src.items == N && src.items_in == -1 && src.children.empty(), how, "'source' is wrong");
+
+  std::ostringstream table, json;
+  FIter::print_probes(table);
+  FIter::print_probes_json(json);
+  expect_text(table.str(), " of " + std::to_string(N) + " in ( 50.0%)", how);
+  expect_text(table.str(), "\n  small ", how);
+  expect_text(table.str(), std::to_string(passed) + " true ( 50.0%)", how);
+  expect_text(json.str(), "\"name\": \"small\", \"kind\": \"callable\", \"items\": " + std::to_string(N) +
+    ", \"items_in\": -1, \"passed\": " + std::to_string(passed), how);
+}
+
+bool check_all() {
+  FIter::reset_probes();
+  bench::keep(probed_for());
+  check_report("range-for");
+  FIter::reset_probes();
+  bench::keep(probed_fold());
+  check_report("Fold");
+  FIter::reset_probes();
+
+  // The least of a few runs, so that a thread switch in a timed item doesn't count.
+  double least = 1e300;
+  for(int run = 0; run < 5; ++run) {
+    {
+      auto p = FIter::Probe("vector")(v.begin(), v.end());
+      long sum = 0;
+      for(auto x : p) sum += x;
+      bench::keep(sum);
+    }
+    for(const FIter::ProbeReport& r : FIter::probe_report()) {
+      if(r.name != "vector") continue;
+      expect(r.items == N, "range-for", "a probe over a vector has the wrong count");
+      least = std::min(least, r.own_ns_per_item);
+    }
+    FIter::reset_probes();
+  }
+  if(least > 2) {
+    std::fprintf(stderr, "probes: a probe over a vector reports %.2f ns/item of its own\n", least);
+    std::abort();
+  }
+  return true;
+}
+
+BENCH_CASE("Filter and Map, range-for", "raw loop", N, [] {
+  static bool checked = check_all();
+  bench::keep(checked);
+  long sum = 0;
+  for(auto x : v) if(small(x)) sum += square(x);
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter and Map, range-for", "FIter", N, [] {
+  auto f = FIter::Filter(small)(v.begin(), v.end());
+  auto m = FIter::Map(square)(f.begin(), f.end());
+  long sum = 0;
+  for(auto x : m) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter and Map, range-for", "FIter, probed", N, [] {
+  bench::keep(probed_for());
+});
+
+BENCH_CASE("Filter and Map, Fold", "raw loop", N, [] {
+  long sum = 0;
+  for(auto x : v) if(small(x)) sum += square(x);
+  bench::keep(sum);
+});
+
+BENCH_CASE("Filter and Map, Fold", "FIter", N, [] {
+  auto f = FIter::Filter(small)(v.begin(), v.end());
+  auto m = FIter::Map(square)(f.begin(), f.end());
+  bench::keep(FIter::Fold(0L, std::plus<long>())(m.begin(), m.end()));
+});
+
+BENCH_CASE("Filter and Map, Fold", "FIter, probed", N, [] {
+  bench::keep(probed_fold());
+});
+
+}
@@ -0,0 +1,78 @@
+#include <numeric>
+#include <vector>
+#include "bench.h"
+#include "../src/Collect.h"
+#include "../src/Progression.h"
+#include "../src/Simd.h"
+#include "../src/Take.h"
+
+// Materialising an arithmetic progression into a vector: std::iota (which only counts by
+// ones, adding each time), the loop one would write for start + i*step, and collecting a
+// Take over a Progression, which fills blocks with simd::fill. Collect makes a new vector
+// each time, which costs more than filling it, so the last two cases of each group are
+// the ones to compare.
+
+namespace {
+
+const long N = 1 << 22;
+
+std::vector<long> longs(N);
+std::vector<double> doubles(N);
+
+BENCH_CASE("fill long 0, 1, 2...", "std::iota", N, [] {
+  std::iota(longs.begin(), longs.end(), 0L);
+  bench::keep(longs.back());
+});
+
+BENCH_CASE("fill long 0, 1, 2...", "loop, i", N, [] {
+  for(long i = 0; i < N; ++i) longs[i] = i;
+  bench::keep(longs.back());
+});
+
+BENCH_CASE("fill long 0, 1, 2...", "simd::fill", N, [] {
+  FIter::simd::fill(longs.data(), N, 0L, 1L, 0);
+  bench::keep(longs.back());
+});
+
+BENCH_CASE("fill long 0, 1, 2...", "new vector, std::iota", N, [] {
+  std::vector<long> v(N);
+  std::iota(v.begin(), v.end(), 0L);
+  bench::keep(v.back());
+});
+
+BENCH_CASE("fill long 0, 1, 2...", "Collect(Take(Progression()))", N, [] {
+  auto p = FIter::Progression();
+  auto v = FIter::Collect<std::vector<long>>()(FIter::Take(N)(p.begin(), p.end()));
+  bench::keep(v.back());
+});
+
+BENCH_CASE("fill double 5, 5.1, 5.2...", "adding step each time", N, [] {
+  // the nearest std::iota gets, with rounding building up.
+  double x = 5.0;
+  for(auto& d : doubles) { d = x; x += 0.1; }
+  bench::keep(doubles.back());
+});
+
+BENCH_CASE("fill double 5, 5.1, 5.2...", "loop, start + i*step", N, [] {
+  for(long i = 0; i < N; ++i) doubles[i] = 5.0 + 0.1 * double(i);
+  bench::keep(doubles.back());
+});
+
+BENCH_CASE("fill double 5, 5.1, 5.2...", "simd::fill", N, [] {
+  FIter::simd::fill(doubles.data(), N, 5.0, 0.1, 0);
+  bench::keep(doubles.back());
+});
+
+BENCH_CASE("fill double 5, 5.1, 5.2...", "new vector, start + i*step", N, [] {
+  std::vector<double> v(N);
+  for(long i = 0; i < N; ++i) v[i] = 5.0 + 0.1 * double(i);
+  bench::keep(v.back());
+});
+
+BENCH_CASE("fill double 5, 5.1, 5.2...", "Collect(Take(Progression()))", N, [] {
+  auto p = FIter::Progression(5.0, 0.1);
+  auto v = FIter::Collect<std::vector<double>>()(FIter::Take(N)(p.begin(), p.end()));
+  bench::keep(v.back());
+});
+
+}
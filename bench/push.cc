@@ -0,0 +1,71 @@
+#include <vector>
+#include "bench.h"
+#include "../src/Filter.h"
+#include "../src/Fold.h"
+#include "../src/Map.h"
+#include "../src/Take.h"
+
+// Summing a pipeline over a vector by pulling items through its iterators (range-for)
+// and by pushing them through its stages (Fold). The hand-written loops are what Fold
+// should compile down to; over Map alone that loop vectorises.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+auto times3 = [](int x) { return x * 3 + 1; };
+auto even = [](int x) { return x % 2 == 0; };
+auto add = [](int a, int x) { return a + x; };
+
+BENCH_CASE("sum map", "hand-written loop", N, [] {
+  int sum = 0;
+  for(auto x : v) sum += times3(x);
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum map", "range-for", N, [] {
+  auto m = FIter::Map(times3)(v.begin(), v.end());
+  int sum = 0;
+  for(auto x : m) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum map", "Fold", N, [] {
+  auto m = FIter::Map(times3)(v.begin(), v.end());
+  bench::keep(FIter::Fold(0, add)(m));
+});
+
+BENCH_CASE("sum map-filter-take", "hand-written loop", N, [] {
+  int sum = 0;
+  long taken = 0;
+  for(auto it = v.begin(); it != v.end() && taken < N / 4; ++it) {
+    int x = times3(*it);
+    if(even(x)) { sum += x; ++taken; }
+  }
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum map-filter-take", "range-for", N, [] {
+  auto m = FIter::Map(times3)(v.begin(), v.end());
+  auto f = FIter::Filter(even)(m.begin(), m.end());
+  auto t = FIter::Take(N / 4)(f.begin(), f.end());
+  int sum = 0;
+  for(auto x : t) sum += x;
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum map-filter-take", "Fold", N, [] {
+  auto m = FIter::Map(times3)(v.begin(), v.end());
+  auto f = FIter::Filter(even)(m.begin(), m.end());
+  auto t = FIter::Take(N / 4)(f.begin(), f.end());
+  bench::keep(FIter::Fold(0, add)(t));
+});
+
+}
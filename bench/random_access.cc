@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <vector>
+#include "bench.h"
+#include "../src/Drop.h"
+#include "../src/Progression.h"
+#include "../src/Take.h"
+#include "../src/Zip.h"
+
+// Operations which should take constant or logarithmic time over random access stages.
+// Each case is a single operation (so 'ns/element' is per operation) over a million
+// items; the std::list cases show the linear time they would take otherwise.
+
+namespace {
+
+const long N = 1000000;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)i;
+  return v;
+}
+std::vector<int> v = input();
+std::list<int> l(v.begin(), v.end());
+
+BENCH_CASE("Drop(n).begin(), n = 1M - 1", "std::next over vector", 1, [] {
+  bench::keep(*std::next(v.begin(), N - 1));
+});
+
+BENCH_CASE("Drop(n).begin(), n = 1M - 1", "Drop over vector", 1, [] {
+  auto d = FIter::Drop(N - 1)(v.begin(), v.end());
+  bench::keep(*d.begin());
+});
+
+BENCH_CASE("Drop(n).begin(), n = 1M - 1", "Drop over std::list", 1, [] {
+  auto d = FIter::Drop(N - 1)(l.begin(), l.end());
+  bench::keep(*d.begin());
+});
+
+BENCH_CASE("lower_bound over Take(1M)", "std::lower_bound over vector", 1, [] {
+  bench::keep(*std::lower_bound(v.begin(), v.end(), N / 3));
+});
+
+BENCH_CASE("lower_bound over Take(1M)", "std::lower_bound over Take", 1, [] {
+  auto t = FIter::Take(N)(v.begin(), v.end());
+  bench::keep(*std::lower_bound(t.begin(), t.end(), N / 3));
+});
+
+BENCH_CASE("lower_bound over Take(1M)", "std::lower_bound over std::list", 1, [] {
+  bench::keep(*std::lower_bound(l.begin(), l.end(), N / 3));
+});
+
+BENCH_CASE("distance over Zip(1M)", "subtracting vector iterators", 1, [] {
+  bench::keep(v.end() - v.begin());
+});
+
+BENCH_CASE("distance over Zip(1M)", "std::distance over Zip", 1, [] {
+  auto z = FIter::Zip(v.begin(), v.end())(v.begin(), v.end());
+  bench::keep(std::distance(z.begin(), z.end()));
+});
+
+BENCH_CASE("nth item of a Progression, n = 1M", "start + n*step", 1, [] {
+  long start = 7, step = 3;
+  bench::keep(start);
+  bench::keep(start + N * step);
+});
+
+BENCH_CASE("nth item of a Progression, n = 1M", "Progression begin() + n", 1, [] {
+  long start = 7, step = 3;
+  bench::keep(start);
+  bench::keep(*(FIter::Progression(start, step).begin() + N));
+});
+
+}
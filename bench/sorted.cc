@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <vector>
+#include "bench.h"
+#include "../src/DropWhile.h"
+#include "../src/Pipe.h"
+#include "../src/Sorted.h"
+#include "../src/TakeWhile.h"
+
+// Slicing a sorted vector of 10^7 timestamps by time, as 'drop while t < from, take while
+// t < to': with std::lower_bound, with plain DropWhile and TakeWhile (which test every item
+// up to the end of the slice), and with their predicates marked Sorted (see Sorted.h),
+// which search. Each pass counts the items in one slice, and counts as one element, so
+// figures are per slice.
+//
+// The vector is 80MB, made on first use. (Slice 10^8 timestamps by raising N, given 800MB
+// to spare: only the DropWhile and TakeWhile figures grow, tenfold.)
+
+namespace {
+
+const long N = 10000000;
+
+const std::vector<long>& timestamps() {
+  static std::vector<long> ts;
+  if(ts.empty()) {
+    ts.resize(N);
+    for(long i = 0; i < N; ++i) ts[i] = i * 3;
+  }
+  return ts;
+}
+
+template <class Slice>
+long count(const Slice& s) {
+  long n = 0;
+  for(auto it = s.begin(), end = s.end(); it != end; ++it) ++n;
+  return n;
+}
+
+void add(const char* group, long from, long to) {
+  bench::Register(group, "std::lower_bound", 1, [from, to] {
+    const std::vector<long>& ts = timestamps();
+    auto lo = std::lower_bound(ts.begin(), ts.end(), from);
+    auto hi = std::lower_bound(lo, ts.end(), to);
+    bench::keep(hi - lo);
+  });
+  bench::Register(group, "DropWhile, TakeWhile", 1, [from, to] {
+    auto slice = timestamps() | FIter::DropWhile([from](long t) { return t < from; }) | FIter::TakeWhile([to](long t) { return t < to; });
+    bench::keep(count(slice));
+  });
+  bench::Register(group, "Sorted", 1, [from, to] {
+    auto slice = timestamps() | FIter::DropWhile(FIter::Sorted([from](long t) { return t < from; })) | FIter::TakeWhile(FIter::Sorted([to](long t) { return t < to; }));
+    bench::keep(slice.size());
+  });
+}
+
+struct Register_all {
+  Register_all() {
+    add("sorted slice, middle 20%", 3 * N * 2 / 5, 3 * N * 3 / 5);
+    add("sorted slice, 1000 items near the end", 3 * (N - 2000), 3 * (N - 1000));
+  }
+} register_all;
+
+}
@@ -0,0 +1,216 @@
+#include <deque>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bench.h"
+#include "../src/Chain.h"
+#include "../src/Drop.h"
+#include "../src/DropWhile.h"
+#include "../src/Filter.h"
+#include "../src/Map.h"
+#include "../src/Progression.h"
+#include "../src/Take.h"
+#include "../src/TakeWhile.h"
+#include "../src/Zip.h"
+
+// Every stage, and a few common compositions, walked with range-for against the loop one
+// would write instead, over ints and doubles, at sizes which fit in L1 (4-8KB), in L2
+// (128-256KB) and only in DRAM (32-64MB). The ratio is the abstraction penalty; none of
+// these should allocate.
+//
+// Inputs are i * 7 % 1000, so that 'x < 500' passes half of them and 999 first comes at
+// position 857.
+
+namespace {
+
+struct Size {
+  const char* name;
+  long n;
+};
+const Size sizes[] = {{"L1", 1 << 10}, {"L2", 1 << 15}, {"DRAM", 1 << 23}};
+
+template <class T> const char* type_name();
+template <> const char* type_name<int>() { return "int"; }
+template <> const char* type_name<double>() { return "double"; }
+
+// Sums of ints are kept in a long.
+template <class T>
+using sum_t = typename std::conditional<std::is_integral<T>::value, long, double>::type;
+
+template <class T>
+const std::vector<T>& input(long n) {
+  static std::deque<std::vector<T>> made; // one per size, never moved
+  for(auto& v : made)
+    if((long)v.size() == n) return v;
+  made.emplace_back(n);
+  for(long i = 0; i < n; ++i) made.back()[i] = (T)(i * 7 % 1000);
+  return made.back();
+}
+
+template <class Raw, class Staged>
+void add(const char* stage, const char* type, const Size& size, Raw raw, Staged staged) {
+  std::string group = std::string(stage) + ", " + type + ", " + size.name;
+  bench::Register(group, "raw loop", size.n, raw);
+  bench::Register(group, "FIter", size.n, staged);
+}
+
+template <class T>
+void add_all(const Size& size) {
+  typedef sum_t<T> S;
+  const std::vector<T>& v = input<T>(size.n);
+  const std::vector<T>& w = input<T>(size.n); // the same vector, for Zip and Chain
+  long n = size.n;
+  const char* type = type_name<T>();
+
+  auto map = [](T x) { return x * 3 + 1; };
+  auto small = [](T x) { return x < 500; };
+  auto below = [](T x) { return x < 1000; };
+  auto not999 = [](T x) { return x != 999; };
+
+  add("Map", type, size, [&v, map] {
+    S sum = 0;
+    for(auto x : v) sum += map(x);
+    bench::keep(sum);
+  }, [&v, map] {
+    S sum = 0;
+    for(auto x : FIter::Map(map)(v.begin(), v.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Filter", type, size, [&v, small] {
+    S sum = 0;
+    for(auto x : v) if(small(x)) sum += x;
+    bench::keep(sum);
+  }, [&v, small] {
+    S sum = 0;
+    for(auto x : FIter::Filter(small)(v.begin(), v.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Take(n / 2)", type, size, [&v, n] {
+    S sum = 0;
+    for(long i = 0; i < n / 2; ++i) sum += v[i];
+    bench::keep(sum);
+  }, [&v, n] {
+    S sum = 0;
+    for(auto x : FIter::Take(n / 2)(v.begin(), v.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("TakeWhile, to the end", type, size, [&v, below] {
+    S sum = 0;
+    for(auto it = v.begin(); it != v.end() && below(*it); ++it) sum += *it;
+    bench::keep(sum);
+  }, [&v, below] {
+    S sum = 0;
+    for(auto x : FIter::TakeWhile(below)(v.begin(), v.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Drop(n / 2)", type, size, [&v, n] {
+    S sum = 0;
+    for(long i = n / 2; i < n; ++i) sum += v[i];
+    bench::keep(sum);
+  }, [&v, n] {
+    S sum = 0;
+    for(auto x : FIter::Drop(n / 2)(v.begin(), v.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("DropWhile", type, size, [&v, not999] {
+    S sum = 0;
+    auto it = v.begin();
+    while(it != v.end() && not999(*it)) ++it;
+    for(; it != v.end(); ++it) sum += *it;
+    bench::keep(sum);
+  }, [&v, not999] {
+    S sum = 0;
+    for(auto x : FIter::DropWhile(not999)(v.begin(), v.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Chain of two halves", type, size, [&v, &w, n] {
+    S sum = 0;
+    for(long i = 0; i < n / 2; ++i) sum += v[i];
+    for(long i = n / 2; i < n; ++i) sum += w[i];
+    bench::keep(sum);
+  }, [&v, &w, n] {
+    S sum = 0;
+    for(auto x : FIter::Chain(v.begin(), v.begin() + n / 2)(w.begin() + n / 2, w.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Zip of two", type, size, [&v, &w, n] {
+    S sum = 0;
+    for(long i = 0; i < n; ++i) sum += v[i] * w[i];
+    bench::keep(sum);
+  }, [&v, &w] {
+    S sum = 0;
+    for(auto [a, b] : FIter::Zip(v, w)) sum += a * b;
+    bench::keep(sum);
+  });
+
+  add("Take(n) of Progression", type, size, [n] {
+    S sum = 0;
+    for(long i = 0; i < n; ++i) sum += (T)i;
+    bench::keep(sum);
+  }, [n] {
+    S sum = 0;
+    auto p = FIter::Progression((T)0, (T)1);
+    for(auto x : FIter::Take(n)(p.begin(), p.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Map, Filter, Take(n / 4)", type, size, [&v, n, map] {
+    S sum = 0;
+    long taken = 0;
+    for(auto it = v.begin(); it != v.end() && taken < n / 4; ++it) {
+      T x = map(*it);
+      if((long)x % 2 == 0) { sum += x; ++taken; }
+    }
+    bench::keep(sum);
+  }, [&v, n, map] {
+    S sum = 0;
+    auto m = FIter::Map(map)(v.begin(), v.end());
+    auto f = FIter::Filter([](T x) { return (long)x % 2 == 0; })(m.begin(), m.end());
+    for(auto x : FIter::Take(n / 4)(f.begin(), f.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Zip, Map, Filter", type, size, [&v, &w, n] {
+    S sum = 0;
+    for(long i = 0; i < n; ++i) {
+      T x = v[i] * w[i];
+      if(x < 250000) sum += x;
+    }
+    bench::keep(sum);
+  }, [&v, &w] {
+    S sum = 0;
+    auto z = FIter::Zip(v, w);
+    auto m = FIter::Map([](auto t) { return std::get<0>(t) * std::get<1>(t); })(z.begin(), z.end());
+    for(auto x : FIter::Filter([](T x) { return x < 250000; })(m.begin(), m.end())) sum += x;
+    bench::keep(sum);
+  });
+
+  add("Drop, TakeWhile, Map", type, size, [&v, n, map] {
+    S sum = 0;
+    for(long i = n / 4; i < n && v[i] < 1000; ++i) sum += map(v[i]);
+    bench::keep(sum);
+  }, [&v, n, map, below] {
+    S sum = 0;
+    auto d = FIter::Drop(n / 4)(v.begin(), v.end());
+    auto t = FIter::TakeWhile(below)(d.begin(), d.end());
+    for(auto x : FIter::Map(map)(t.begin(), t.end())) sum += x;
+    bench::keep(sum);
+  });
+}
+
+bool registered = [] {
+  for(const Size& size : sizes) {
+    add_all<int>(size);
+    add_all<double>(size);
+  }
+  return true;
+}();
+
+}
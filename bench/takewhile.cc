@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "bench.h"
+#include "../src/TakeWhile.h"
+
+// TakeWhile with a predicate that counts its calls, and which holds for every element, so
+// that the loop runs to the end of the vector. The predicate should be called once per
+// element, and never on the end of the vector: each case checks that it was, N times
+// exactly, and the program stops if not.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+bool counted_small(int x) {
+  ++bench::calls();
+  return x < 1000;
+}
+
+void expect_calls(const char* name, long before) {
+  long n = bench::calls() - before;
+  if(n != N) {
+    std::fprintf(stderr, "TakeWhile with %s called its predicate %ld times over %ld elements\n", name, n, N);
+    std::abort();
+  }
+}
+
+BENCH_CASE("takewhile predicate calls", "hand-written loop", N, [] {
+  long before = bench::calls();
+  long sum = 0;
+  for(auto it = v.begin(); it != v.end() && counted_small(*it); ++it) sum += *it;
+  bench::keep(sum);
+  expect_calls("a hand-written loop", before);
+});
+
+BENCH_CASE("takewhile predicate calls", "range-for", N, [] {
+  long before = bench::calls();
+  auto tw = FIter::TakeWhile(counted_small)(v.begin(), v.end());
+  long sum = 0;
+  for(auto x : tw) sum += x;
+  bench::keep(sum);
+  expect_calls("range-for", before);
+});
+
+BENCH_CASE("takewhile predicate calls", "postfix increment", N, [] {
+  long before = bench::calls();
+  auto tw = FIter::TakeWhile(counted_small)(v.begin(), v.end());
+  long sum = 0;
+  auto end = tw.end();
+  for(auto it = tw.begin(); it != end; it++) sum += *it;
+  bench::keep(sum);
+  expect_calls("postfix increments", before);
+});
+
+}
@@ -0,0 +1,113 @@
+// Tracing is on for this program only (bench_traced, built from this file and main.cc with
+// -DFITER_TRACING: see the Makefile), to measure what it costs when on, and to check that
+// the trace it writes has the spans it should. Compiled out, FITER_TRACE is nothing at
+// all, so there is nothing to measure.
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "../src/Collect.h"
+#include "../src/Filter.h"
+#include "../src/Fold.h"
+#include "../src/ForEach.h"
+#include "../src/Map.h"
+#include "../src/Prefetch.h"
+#include "../src/Trace.h"
+
+static_assert(FIter::tracing_enabled, "bench/trace.cc must be compiled with -DFITER_TRACING");
+
+// A Filter over a Map, collected (a span per block of 256 items, for each stage) and
+// walked in blocks of 16 (sixteen times as many spans), against the loop one would write
+// instead. Then a Map handed over through a Prefetch, whose producer's run and waits are
+// traced.
+//
+// Before the first case is timed, each pipeline is run once on its own, the trace is
+// written with write_trace(), and the program stops unless every stage's spans, and the
+// producer's thread, are in it. Spans are cleared after each timed run, so that they don't
+// pile up over the repetitions.
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<int> input() {
+  std::vector<int> v(N);
+  for(long i = 0; i < N; ++i) v[i] = (int)(i * 7 % 1000);
+  return v;
+}
+std::vector<int> v = input();
+
+auto square = [](int x) { return x * x; };
+auto small = [](int x) { return x < 250000; };
+auto plus = [](long a, int x) { return a + x; };
+
+auto filter_of_map() {
+  auto m = FIter::Map(square)(v.begin(), v.end());
+  return FIter::Filter(small)(m.begin(), m.end());
+}
+
+long prefetched() {
+  auto m = FIter::Map(square)(v.begin(), v.end());
+  return FIter::Fold(0L, plus)(FIter::Prefetch()(m.begin(), m.end()));
+}
+
+void expect_span(const std::string& trace, const char* name) {
+  if(trace.find("\"" + std::string(name) + "\"") == std::string::npos) {
+    std::fprintf(stderr, "the trace written by write_trace() has no '%s'\n", name);
+    std::abort();
+  }
+}
+
+bool check_trace() {
+  FIter::clear_trace();
+  bench::keep(FIter::Collect<std::vector<int>>()(filter_of_map()).size());
+  bench::keep(prefetched());
+  std::ostringstream out;
+  FIter::write_trace(out);
+  std::string trace = out.str();
+  for(const char* name : {"Collect", "Map", "Filter", "Fold", "Prefetch producer"})
+    expect_span(trace, name);
+  FIter::clear_trace();
+  return true;
+}
+
+BENCH_CASE("Filter of Map, traced", "hand-written loop", N, [] {
+  static bool checked = check_trace();
+  bench::keep(checked);
+  std::vector<int> out;
+  out.reserve(N);
+  for(auto x : v) {
+    int y = square(x);
+    if(small(y)) out.push_back(y);
+  }
+  bench::keep(out.size());
+});
+
+BENCH_CASE("Filter of Map, traced", "Collect, blocks of 256", N, [] {
+  bench::keep(FIter::Collect<std::vector<int>>()(filter_of_map()).size());
+  FIter::clear_trace();
+});
+
+BENCH_CASE("Filter of Map, traced", "ForEachBatch, blocks of 16", N, [] {
+  long sum = 0;
+  FIter::ForEachBatch<16>([&sum](int* items, std::size_t n) {
+    for(std::size_t i = 0; i < n; ++i) sum += items[i];
+  })(filter_of_map());
+  bench::keep(sum);
+  FIter::clear_trace();
+});
+
+BENCH_CASE("Map through Prefetch, traced", "Fold", N, [] {
+  auto m = FIter::Map(square)(v.begin(), v.end());
+  bench::keep(FIter::Fold(0L, plus)(m));
+  FIter::clear_trace();
+});
+
+BENCH_CASE("Map through Prefetch, traced", "Fold over Prefetch()", N, [] {
+  bench::keep(prefetched());
+  FIter::clear_trace();
+});
+
+}
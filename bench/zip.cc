@@ -0,0 +1,74 @@
+#include <vector>
+#include "bench.h"
+#include "../src/Zip.h"
+
+// Struct-of-arrays loops over 4 and 8 columns: an indexed loop, against the N-ary Zip
+// (whose elements are tuples of references, and whose loops test a single position for the
+// end), and, for 4 columns, binary Zips nested in each other (whose elements are pairs of
+// pairs, copied out of the columns).
+
+namespace {
+
+const long N = 1 << 20;
+
+std::vector<double> column(int k) {
+  std::vector<double> c(N);
+  for(long i = 0; i < N; ++i) c[i] = (double)((i * (7 + k)) % 1000);
+  return c;
+}
+std::vector<double> c0 = column(0), c1 = column(1), c2 = column(2), c3 = column(3);
+std::vector<double> c4 = column(4), c5 = column(5), c6 = column(6), c7 = column(7);
+
+BENCH_CASE("sum over 4 zipped columns", "indexed loop", N, [] {
+  double sum = 0;
+  for(long i = 0; i < N; ++i)
+    sum += c0[i] * c1[i] + c2[i] - c3[i];
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum over 4 zipped columns", "Zip(c0, c1, c2, c3)", N, [] {
+  double sum = 0;
+  for(auto [a, b, c, d] : FIter::Zip(c0, c1, c2, c3))
+    sum += a * b + c - d;
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum over 4 zipped columns", "nested binary Zips", N, [] {
+  auto z01 = FIter::Zip(c0.begin(), c0.end())(c1.begin(), c1.end());
+  auto z23 = FIter::Zip(c2.begin(), c2.end())(c3.begin(), c3.end());
+  auto z = FIter::Zip(z01.begin(), z01.end())(z23.begin(), z23.end());
+  double sum = 0;
+  for(auto x : z)
+    sum += x.first.first * x.first.second + x.second.first - x.second.second;
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum over 8 zipped columns", "indexed loop", N, [] {
+  double sum = 0;
+  for(long i = 0; i < N; ++i)
+    sum += c0[i] * c1[i] + c2[i] * c3[i] + c4[i] * c5[i] + c6[i] * c7[i];
+  bench::keep(sum);
+});
+
+BENCH_CASE("sum over 8 zipped columns", "Zip(c0, ..., c7)", N, [] {
+  double sum = 0;
+  for(auto [a, b, c, d, e, f, g, h] : FIter::Zip(c0, c1, c2, c3, c4, c5, c6, c7))
+    sum += a * b + c * d + e * f + g * h;
+  bench::keep(sum);
+});
+
+BENCH_CASE("scaling 4 zipped columns in place", "indexed loop", N, [] {
+  for(long i = 0; i < N; ++i) {
+    c0[i] *= 0.5; c1[i] *= 0.5; c2[i] *= 0.5; c3[i] *= 0.5;
+  }
+  bench::keep(c0);
+});
+
+BENCH_CASE("scaling 4 zipped columns in place", "Zip(c0, c1, c2, c3)", N, [] {
+  for(auto [a, b, c, d] : FIter::Zip(c0, c1, c2, c3)) {
+    a *= 0.5; b *= 0.5; c *= 0.5; d *= 0.5;
+  }
+  bench::keep(c0);
+});
+
+}
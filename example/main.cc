@@ -1,13 +1,68 @@
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 #include <vector>
+#include "../src/Collect.h"
+#include "../src/Compare.h"
 #include "../src/Filter.h"
+#include "../src/Map.h"
+#include "../src/Pipe.h"
 #include "../src/Progression.h"
+#include "../src/Take.h"
+#include "../src/Zip.h"
 
 using namespace std; // Don't do this.
 
 
 bool mod2(int i) { return i%2 == 0; }
 //bool mod3(int i) { return i%3 == 0; }
+int times3(int i) { return 3*i; }
+
+
+// Iterators carry nothing beyond the iterator they wrap and their callable, and a
+// stateless callable (like a captureless lambda) takes no space at all.
+typedef vector<int>::iterator vit;
+auto triple = [](int i) { return 3*i; };
+static_assert(sizeof(FIter::MapObject<vit, decltype(&times3)>::const_iterator) == sizeof(vit) + sizeof(&times3), "Map iterator should be its iterator plus its function");
+static_assert(sizeof(FIter::MapObject<vit, decltype(triple)>::const_iterator) == sizeof(vit), "Map iterator should be its iterator alone");
+static_assert(sizeof(FIter::FilteredObject<vit, decltype(&mod2)>::const_iterator) == 2*sizeof(vit) + sizeof(&mod2), "Filter iterator should be its iterators plus its function");
+
+
+// A table worked out at compile time: the CRC-32 of each byte.
+constexpr std::uint32_t crc32_byte(std::uint32_t c) {
+  for(int k=0; k<8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+  return c;
+}
+constexpr auto crc32_table = FIter::Collect<std::array<std::uint32_t, 256>>()(FIter::Progression<std::uint32_t>(0) | FIter::Map(crc32_byte));
+static_assert(crc32_table[1] == 0x77073096u && crc32_table[255] == 0x2D02EF8Du, "CRC-32 table should be worked out at compile time");
+
+
+// The other stages which work at compile time: Filter (with a plain function, and with a
+// Compare.h comparison over an array, which there takes the scalar search rather than the
+// SIMD one of Simd.h), Take, and Zip, collected into arrays of numbers and of pairs.
+constexpr int square(int i) { return i*i; }
+constexpr bool odd(int i) { return i%2 != 0; }
+constexpr int weighted(std::pair<int, int> p) { return p.first * p.second; }
+
+constexpr std::array<int, 12> readings{5, 12, 7, 30, 2, 18, 9, 41, 3, 27, 11, 6};
+constexpr auto weights = FIter::Progression(1);
+
+constexpr auto odd_squares = FIter::Collect<std::array<int, 8>>()(FIter::Progression(0) | FIter::Filter(odd) | FIter::Map(square));
+static_assert(odd_squares[0] == 1 && odd_squares[1] == 9 && odd_squares[7] == 225, "odd squares should be worked out at compile time");
+
+constexpr auto first_squares = FIter::Collect<std::array<int, 5>>()(FIter::Progression(0) | FIter::Map(square) | FIter::Take(5));
+static_assert(first_squares[0] == 0 && first_squares[4] == 16, "Take should work at compile time");
+
+constexpr auto high_readings = FIter::Collect<std::array<int, 6>>()(readings | FIter::Filter(FIter::Greater(10)));
+static_assert(high_readings[0] == 12 && high_readings[3] == 41 && high_readings[5] == 11, "a Compare.h Filter over an array should work at compile time");
+
+constexpr auto numbered = FIter::Collect<std::array<std::pair<int, int>, 3>>()(FIter::Zip(readings.begin(), readings.end())(weights.begin(), weights.end()));
+static_assert(numbered[0] == std::pair<int, int>(5, 1) && numbered[2] == std::pair<int, int>(7, 3), "Zip should work at compile time");
+
+constexpr auto zipped = FIter::Zip(readings.begin(), readings.end())(weights.begin(), weights.end());
+constexpr auto weighted_readings = FIter::Collect<std::array<int, 12>>()(zipped | FIter::Map(weighted));
+static_assert(weighted_readings[1] == 24 && weighted_readings[11] == 72, "Map over Zip should work at compile time");
 
 
 int main() {
@@ -31,6 +86,28 @@ int main() {
   for(auto item : Mod6F) {
     std::cout << item << std::endl;
   }
+
+  // The same, piped; the two Filters become one (see Pipe.h).
+  for(auto item : v | FIter::Filter([](int x){return x%3==0;}) | FIter::Filter(mod2)) {
+    std::cout << item << std::endl;
+  }
+
+
+  // The same table, worked out at run time, is the same.
+  auto crc32_runtime = FIter::Collect<std::array<std::uint32_t, 256>>()(FIter::Progression<std::uint32_t>(0) | FIter::Map(crc32_byte));
+  cout << (crc32_runtime == crc32_table ? "CRC-32 tables match" : "CRC-32 tables differ") << endl;
+
+  // And so are the others, where the Compare.h Filter takes the SIMD path.
+  auto run_readings = readings;
+  auto run_weights = FIter::Progression(1);
+  auto run_zipped = FIter::Zip(run_readings.begin(), run_readings.end())(run_weights.begin(), run_weights.end());
+  bool match =
+    FIter::Collect<std::array<int, 8>>()(FIter::Progression(0) | FIter::Filter(odd) | FIter::Map(square)) == odd_squares &&
+    FIter::Collect<std::array<int, 5>>()(FIter::Progression(0) | FIter::Map(square) | FIter::Take(5)) == first_squares &&
+    FIter::Collect<std::array<int, 6>>()(run_readings | FIter::Filter(FIter::Greater(10))) == high_readings &&
+    FIter::Collect<std::array<std::pair<int, int>, 3>>()(run_zipped) == numbered &&
+    FIter::Collect<std::array<int, 12>>()(run_zipped | FIter::Map(weighted)) == weighted_readings;
+  cout << (match ? "Filter, Take and Zip tables match" : "Filter, Take and Zip tables differ") << endl;
   
   
   
@@ -0,0 +1,234 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A caching iterator.
+//
+// The point of this file. Given a pair of iterators of type IterT, it can create iterators
+// (a nested subtype) exporting all constant functions of the original iterators. However,
+// each of these iterators dereferences the original iterator at most once per position,
+// and keeps the item, in place, until it moves on: so a Cache placed after an expensive
+// Map makes sure that the Filter, TakeWhile, etc. after it (which look at each item more
+// than once) only pay for the Map once. operator* and operator-> give references to the
+// kept item.
+//
+// Copies of an iterator each keep their own item. If a sequence is walked over more than
+// once, or iterators are copied and jump about (as std algorithms do), a Cache can also be
+// given a table of a fixed number of items, shared by all of its iterators: the item at
+// position i goes in slot i % size, replacing whatever was there. Its iterators keep no
+// item of their own, so copying one copies no item, and operator* gives a reference into
+// the table: it lasts until the slot is taken by another position, so the table should be
+// larger than the span of positions in use at once. The table is allocated once, when the
+// Cache is made, and is not locked, so a Cache with a table mustn't be used by several
+// threads at once (as the Parallel terminals would).
+//
+// Internal iteration (see _for_each in FIter.h) passes the original items straight on,
+// each of which is dereferenced once anyway.
+//
+// The end of the pair may be a sentinel of type SentT instead, as for Map. If the original
+// pair is sized (see FIter.h), so is this one, and size() is defined.
+//
+// Create using Cache(), below.
+//
+
+// Usage example:
+//
+// std::vector<std::string> lines = ...;
+// auto parsed = FIter::Map(parse_json)(lines.begin(), lines.end());
+// auto cached = FIter::Cache()(parsed.begin(), parsed.end());
+// auto valid = FIter::Filter(is_valid)(cached.begin(), cached.end());
+//
+// Each line is parsed once, where without the Cache the valid ones would be parsed twice:
+// once to test them, and again to return them.
+
+template<typename IterT, typename SentT = IterT>
+class CacheObject {
+
+  typedef typename std::decay<decltype(*std::declval<IterT>())>::type value_type;
+  typedef typename std::iterator_traits<IterT>::iterator_category iterator_category;
+
+  // The shared table: slot i holds the item at position keys[i], if that isn't 'none'.
+  struct Table {
+    static constexpr std::ptrdiff_t none = PTRDIFF_MIN;
+    std::vector<std::ptrdiff_t> keys;
+    std::vector<std::optional<value_type>> items;
+
+    explicit Table(std::size_t size) : keys(size, none), items(size) {}
+
+    const value_type& get(std::ptrdiff_t pos, const IterT& it) {
+      std::ptrdiff_t n = keys.size();
+      std::size_t slot = ((pos % n) + n) % n;
+      if(keys[slot] != pos) {
+        keys[slot] = none; // in case *it throws
+        items[slot].emplace(*it);
+        keys[slot] = pos;
+      }
+      return *items[slot];
+    }
+  };
+
+ protected:
+  const IterT m_begin;
+  const SentT m_end;
+
+  std::shared_ptr<Table> table;
+
+
+ public:
+  struct sentinel {
+    SentT m_end;
+  };
+
+  struct const_iterator : public Iterator_types<iterator_category, value_type>,
+  public Iterator_base<iterator_category, const_iterator, value_type>
+  {
+    IterT m_cur;
+    std::ptrdiff_t m_pos; // from the start of the Cache, for the table
+    std::shared_ptr<Table> m_table;
+    mutable std::optional<value_type> m_item; // unused with a table
+
+    // Get the iterator at the base of a chain of FIters. For example, if you apply a
+    // filter to a vector, and then a map to the filter, calling this on the map will
+    // return the vector iterator at the current location.
+    // See FIter.h for implementation.
+    auto get_base() -> decltype(_get_base<IterT>(m_cur, 0)) {
+      return _get_base<IterT>(m_cur, 0);
+    }
+
+    const value_type& access() const { // The only thing Caches actually do.
+      if(m_table)
+        return m_table->get(m_pos, m_cur);
+      if(!m_item)
+        m_item.emplace(*m_cur);
+      return *m_item;
+    }
+
+    const value_type& operator*() const { return access(); }
+    const value_type* operator->() const { return &access(); }
+
+    void advance() {
+      ++m_cur;
+      ++m_pos;
+      m_item.reset();
+    }
+
+    void unadvance() {
+      --m_cur;
+      --m_pos;
+      m_item.reset();
+    }
+
+    void advance(std::ptrdiff_t n) {
+      m_cur += n;
+      m_pos += n;
+      m_item.reset();
+    }
+
+    std::ptrdiff_t distance_from(const const_iterator& r) const {
+      return m_cur - r.m_cur;
+    }
+
+    bool reached(const sentinel& s) const {
+      return m_cur == s.m_end;
+    }
+
+    template <class S = SentT>
+    auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t(std::declval<const S&>() - m_cur)) {
+      return s.m_end - m_cur;
+    }
+
+    // Internal iteration: see _for_each in FIter.h. An item already kept is passed on
+    // first, and the rest straight from the original iterators.
+    static const IterT& end_of(const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const sentinel& e) { return e.m_end; }
+    static Unreachable end_of(Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      if(!b.m_item)
+        return _for_each(b.m_cur, end_of(e), sink);
+      if(b.m_cur == end_of(e)) return true;
+      if(!sink(*b.m_item)) return false;
+      return _for_each(std::next(b.m_cur), end_of(e), sink);
+    }
+
+    const_iterator(const IterT & _cur, std::ptrdiff_t _pos, const std::shared_ptr<Table>& _table) : m_cur(_cur), m_pos(_pos), m_table(_table)
+    {}
+  };
+
+
+  CacheObject(IterT _begin, SentT _end, std::size_t table_size) : m_begin(_begin), m_end(_end),
+    table(table_size > 0 ? std::make_shared<Table>(table_size) : nullptr)
+  {}
+
+  const_iterator begin() const {
+    return const_iterator(m_begin, 0, table);
+  }
+
+  // Positions are counted from the beginning. Iterators going back from an end of unknown
+  // length count from far below it instead, so that they never meet those.
+  auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value && is_sized<IterT, SentT>::value)
+      return const_iterator(m_end, _length(m_begin, m_end), table);
+    else if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, PTRDIFF_MIN / 2, table);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel{m_end};
+  }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value>::type>
+  std::ptrdiff_t size() const { // See FIter.h for _length.
+    return _length(m_begin, m_end);
+  }
+};
+
+
+
+
+
+
+
+// Stores a table size. When called on a pair of iterators, returns a CacheObject which
+// iterates between them, dereferencing each at most once per position.
+// Its purposes are to allow currying and implicit template instantiation.
+struct CacheOn {
+  std::size_t table_size;
+
+  CacheOn(std::size_t _table_size) : table_size(_table_size) {}
+
+  template <typename IterT, typename SentT>
+  CacheObject<IterT, SentT> operator() (IterT start, SentT end) {
+    return CacheObject<IterT, SentT>(start, end, table_size);
+  }
+};
+
+
+
+
+
+
+
+// Cache takes an optional table size (by default none, so that each iterator only keeps
+// its current item) and returns a CacheOn<> storing it.
+inline CacheOn Cache(std::size_t table_size = 0) {
+  return CacheOn(table_size);
+}
+
+
+
+
+
+}
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <functional>
 #include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 #include "FIter.h"
 
 namespace FIter {
@@ -12,7 +15,7 @@ namespace FIter {
 // A 'chaining' iterator.
 //
 // The point of this file. Given two iterators, it returns an iterator over the two taken
-// sequentially (like concatenation).
+// sequentially (like concatenation). (For more than two, see ChainNObject, below.)
 //
 // Create using Chain(), below.
 //
@@ -21,6 +24,12 @@ namespace FIter {
 // 'invalid conversion' error: however, this won't happen unless your code actually uses
 // the iterator, because otherwise the function causing this error won't be generated.
 //
+// The ends of the pairs may be sentinels of types SentT_1 and SentT_2 instead. end() is a
+// const_iterator when they are the iterator types, an Unreachable when the second is, and
+// otherwise a sentinel wrapping the second end.
+//
+// If both pairs are sized (see FIter.h), so is this one, and size() is defined.
+//
 
 // Usage example:
 //
@@ -32,36 +41,40 @@ namespace FIter {
 // 
 // This will print '0,1,2,3,4,5,6,'
 
-template<typename IterT_1, typename IterT_2>
+template<typename IterT_1, typename IterT_2, typename SentT_1 = IterT_1, typename SentT_2 = IterT_2>
 class ChainObject {
 
 
 	// the value types of the sub-iterators.
 	
-	typedef typename IterT_1::value_type value_type_1;
-	typedef typename IterT_2::value_type value_type_2;
+	typedef typename std::iterator_traits<IterT_1>::value_type value_type_1;
+	typedef typename std::iterator_traits<IterT_2>::value_type value_type_2;
 
 	// the type of this iterator must be unchanging, so value_type_2 will need to be able to
 	// be coerced to match value_type_1
   typedef value_type_1 value_type;
   
 	// Only support input / forward iterators.
-  typedef typename least_iterator_type<typename IterT_1::iterator_category, typename IterT_2::iterator_category>::type least_common_subtype_p;
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT_1>::iterator_category, typename std::iterator_traits<IterT_2>::iterator_category>::type least_common_subtype_p;
   typedef typename least_iterator_type<least_common_subtype_p, std::forward_iterator_tag>::type least_common_subtype;
 
  protected:
   const IterT_1 m_begin_1;
-  const IterT_1 m_end_1;
+  const SentT_1 m_end_1;
   const IterT_2 m_begin_2;
-  const IterT_2 m_end_2;
+  const SentT_2 m_end_2;
 
 
  public:
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
+  struct sentinel {
+    SentT_2 m_end_2;
+  };
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
   public Iterator_base<least_common_subtype, const_iterator, value_type>
   {
     IterT_1 m_cur_1;
-    IterT_1 m_end_1;
+    SentT_1 m_end_1;
     IterT_2 m_cur_2;
 
    
@@ -101,10 +114,54 @@ class ChainObject {
 		bool operator==(const const_iterator& r) const { return (m_cur_1 == r.m_cur_1 && m_cur_2 == r.m_cur_2); }
 		bool operator!=(const const_iterator& r) const { return !(operator==(r)); }
 
+		bool reached(const sentinel& s) const { return (m_cur_1 == m_end_1 && m_cur_2 == s.m_end_2); }
+
+		template <class S_1 = SentT_1, class S_2 = SentT_2>
+		auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t((std::declval<const S_1&>() - m_cur_1) + (std::declval<const S_2&>() - m_cur_2))) {
+			return (m_end_1 - m_cur_1) + (s.m_end_2 - m_cur_2);
+		}
+
+		// Internal iteration: see _for_each in FIter.h. Each pair gets a loop of its own, so
+		// there's no choosing between them per item.
+		static const IterT_2& end_of(const const_iterator& e) { return e.m_cur_2; }
+		static const SentT_2& end_of(const sentinel& e) { return e.m_end_2; }
+		static Unreachable end_of(Unreachable) { return Unreachable(); }
+
+		template <class S, class Sink>
+		static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+			if constexpr (std::is_same<S, const_iterator>::value) {
+				if(e.m_cur_1 != e.m_end_1) // e is within the first pair
+					return _for_each(b.m_cur_1, e.m_cur_1, sink);
+			}
+			if(!_for_each(b.m_cur_1, b.m_end_1, sink)) return false;
+			if constexpr (std::is_same<value_type_1, value_type_2>::value)
+				return _for_each(b.m_cur_2, end_of(e), sink);
+			else
+				return _for_each(b.m_cur_2, end_of(e), [&](auto&& x) { return sink(value_type(std::forward<decltype(x)>(x))); });
+		}
+
+		template <std::size_t N, class S, class Sink>
+		static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+			if constexpr (std::is_same<S, const_iterator>::value) {
+				if(e.m_cur_1 != e.m_end_1)
+					return _for_each_batch<N>(b.m_cur_1, e.m_cur_1, sink);
+			}
+			if(!_for_each_batch<N>(b.m_cur_1, b.m_end_1, sink)) return false;
+			if constexpr (std::is_same<value_type_1, value_type_2>::value)
+				return _for_each_batch<N>(b.m_cur_2, end_of(e), sink);
+			else
+				return _for_each_batch<N>(b.m_cur_2, end_of(e), [&](auto* items, std::size_t n) {
+					value_type converted[N];
+					for(std::size_t i = 0; i < n; ++i)
+						converted[i] = value_type(std::move(items[i]));
+					return sink(converted, n);
+				});
+		}
+
 
    
 
-    const_iterator(const IterT_1& _cur_1, const IterT_1& _end_1, const IterT_2& _cur_2) : m_cur_1(_cur_1), m_end_1(_end_1), m_cur_2(_cur_2)
+    const_iterator(const IterT_1& _cur_1, const SentT_1& _end_1, const IterT_2& _cur_2) : m_cur_1(_cur_1), m_end_1(_end_1), m_cur_2(_cur_2)
     {} 
 
     const_iterator(const const_iterator& r) : m_cur_1(r.m_cur_1), m_end_1(r.m_end_1), m_cur_2(r.m_cur_2)
@@ -115,7 +172,7 @@ class ChainObject {
   };
   
 
-  ChainObject(IterT_1 _begin_1, IterT_1 _end_1, IterT_2 _begin_2, IterT_2 _end_2) :
+  ChainObject(IterT_1 _begin_1, SentT_1 _end_1, IterT_2 _begin_2, SentT_2 _end_2) :
   	m_begin_1(_begin_1), m_end_1(_end_1), m_begin_2(_begin_2), m_end_2(_end_2)
   {}
    
@@ -123,8 +180,18 @@ class ChainObject {
     return const_iterator(m_begin_1, m_end_1, m_begin_2);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end_1, m_end_1, m_end_2);
+  auto end() const {
+    if constexpr (std::is_same<IterT_1, SentT_1>::value && std::is_same<IterT_2, SentT_2>::value)
+      return const_iterator(m_end_1, m_end_1, m_end_2);
+    else if constexpr (std::is_same<SentT_2, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel{m_end_2};
+  }
+
+  template <class S_1 = SentT_1, class S_2 = SentT_2, class = typename std::enable_if<is_sized<IterT_1, S_1>::value && is_sized<IterT_2, S_2>::value>::type>
+  std::ptrdiff_t size() const { // See FIter.h for _length.
+    return _length(m_begin_1, m_end_1) + _length(m_begin_2, m_end_2);
   }
 };
 
@@ -137,16 +204,16 @@ class ChainObject {
 // Stores a pair of iterators. When called on a pair of iterators, returns a ChainObject
 // iterating over the two in succession.
 // Its purposes are to allow currying and implicit template instantiation.
-template <typename IterT_1>
+template <typename IterT_1, typename SentT_1>
 struct ChainWith {
 	IterT_1 begin_1;
-	IterT_1 end_1;
+	SentT_1 end_1;
   
-  ChainWith(IterT_1 _begin_1, IterT_1 _end_1) : begin_1(_begin_1), end_1(_end_1) {}
+  ChainWith(IterT_1 _begin_1, SentT_1 _end_1) : begin_1(_begin_1), end_1(_end_1) {}
   
-  template <typename IterT_2>
-  ChainObject<IterT_1, IterT_2> operator() (IterT_2 begin_2, IterT_2 end_2) {
-    return ChainObject<IterT_1, IterT_2>(begin_1, end_1, begin_2, end_2);
+  template <typename IterT_2, typename SentT_2>
+  ChainObject<IterT_1, IterT_2, SentT_1, SentT_2> operator() (IterT_2 begin_2, SentT_2 end_2) {
+    return ChainObject<IterT_1, IterT_2, SentT_1, SentT_2>(begin_1, end_1, begin_2, end_2);
   }
 };
 
@@ -159,9 +226,217 @@ struct ChainWith {
 // Chain takes a pair of iterators and returns a ChainWith<> storing those itertors.
 // Only necessary to allow implicit template instantiation.
 
-template<typename IterT_1>
-ChainWith<IterT_1> Chain(IterT_1 begin, IterT_1 end) {
-  return ChainWith<IterT_1>(begin, end);
+template<typename IterT_1, typename SentT_1, class = typename std::enable_if<!is_range<IterT_1>::value>::type>
+ChainWith<IterT_1, SentT_1> Chain(IterT_1 begin, SentT_1 end) {
+  return ChainWith<IterT_1, SentT_1>(begin, end);
+}
+
+
+
+
+
+
+
+// An N-ary 'chaining' iterator.
+//
+// Given any number of pairs of iterators, all of type IterT ending in type SentT (such as
+// the begin()s and end()s of many vectors), it returns an iterator over all of them taken
+// sequentially. The pairs (segments) are kept in a list, and an iterator keeps its place
+// in the list and in its segment: moving on compares it with the end of its own segment
+// only, however many segments there are, and empty segments are skipped as soon as they are
+// reached, so dereferencing never needs to choose.
+//
+// Internal iteration (see _for_each in FIter.h), and so Fold, ForEach, Collect and the
+// rest, run a loop of their own over each segment, with nothing per item but the segment's
+// own work.
+//
+// end() is an iterator at the end of the last segment, or, if the segments end in sentinels
+// of type SentT instead, an empty sentinel. The list is kept by the object, and its
+// iterators point into it, so the object must outlive them (and so can't be a temporary on
+// the left of '|': see Pipe.h), as must the ranges the segments are taken from.
+//
+// If the segments are sized (see FIter.h), so is this object, and size() (added up once,
+// when it is made) is defined.
+//
+// Create using Chain(), below, with two or more ranges of the same type, or with a range
+// of ranges (such as a vector of vectors) whose length is only known at run time.
+//
+
+// Usage example:
+//
+// std::vector<std::vector<int>> shards{{0, 1}, {}, {2, 3, 4}};
+// for(auto x : FIter::Chain(shards))
+//   std::cout << x << ',';
+//
+// This will print '0,1,2,3,4,'
+
+template<typename IterT, typename SentT = IterT>
+class ChainNObject {
+
+  typedef typename std::decay<decltype(*std::declval<IterT>())>::type value_type;
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT>::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+
+ public:
+  typedef std::pair<IterT, SentT> segment;
+
+ protected:
+  std::vector<segment> m_segments;
+  std::ptrdiff_t m_size;
+
+
+ public:
+  typedef void owns_items; // Its iterators point into its list: see FIter.h.
+
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
+  public Iterator_base<least_common_subtype, const_iterator, value_type>
+  {
+    const segment* m_seg;
+    const segment* m_last;
+    IterT m_cur;
+    SentT m_seg_end; // m_seg->second, kept here so that moving on needn't load it
+
+    value_type access() const { return *m_cur; }
+
+    void advance() {
+      ++m_cur;
+      if(m_cur == m_seg_end) skip();
+    }
+
+    // Moves to the beginning of the next segment which isn't empty, if there is one.
+    void skip() {
+      while(m_cur == m_seg_end && m_seg != m_last) {
+        ++m_seg;
+        m_cur = m_seg->first;
+        m_seg_end = m_seg->second;
+      }
+    }
+
+    bool operator==(const const_iterator& r) const { return (m_seg == r.m_seg && m_cur == r.m_cur); }
+    bool operator!=(const const_iterator& r) const { return !(operator==(r)); }
+
+    // Since empty segments are skipped, only the last segment's end is ever reached.
+    bool reached(const sentinel&) const { return (m_seg == m_last && m_cur == m_seg_end); }
+
+    // Internal iteration: see _for_each in FIter.h. A loop per segment, up to e's place.
+    template <class Sink>
+    static bool push(const const_iterator& b, const sentinel&, Sink& sink) {
+      if(!_for_each(b.m_cur, b.m_seg->second, sink)) return false;
+      for(const segment* s = b.m_seg + 1; s <= b.m_last; ++s)
+        if(!_for_each(s->first, s->second, sink)) return false;
+      return true;
+    }
+
+    template <class Sink>
+    static bool push(const const_iterator& b, const const_iterator& e, Sink& sink) {
+      if(b.m_seg == e.m_seg)
+        return _for_each(b.m_cur, e.m_cur, sink);
+      if(!_for_each(b.m_cur, b.m_seg->second, sink)) return false;
+      for(const segment* s = b.m_seg + 1; s != e.m_seg; ++s)
+        if(!_for_each(s->first, s->second, sink)) return false;
+      return _for_each(e.m_seg->first, e.m_cur, sink);
+    }
+
+    // Each segment's blocks are traced as a whole (see Trace.h).
+    template <std::size_t N, class I, class S, class Sink>
+    static bool push_segment(const I& from, const S& to, Sink& sink) {
+      FITER_TRACE("Chain segment");
+      return _for_each_batch<N>(from, to, sink);
+    }
+
+    template <std::size_t N, class Sink>
+    static bool push_batch(const const_iterator& b, const sentinel&, Sink& sink) {
+      if(!push_segment<N>(b.m_cur, b.m_seg->second, sink)) return false;
+      for(const segment* s = b.m_seg + 1; s <= b.m_last; ++s)
+        if(!push_segment<N>(s->first, s->second, sink)) return false;
+      return true;
+    }
+
+    template <std::size_t N, class Sink>
+    static bool push_batch(const const_iterator& b, const const_iterator& e, Sink& sink) {
+      if(b.m_seg == e.m_seg)
+        return push_segment<N>(b.m_cur, e.m_cur, sink);
+      if(!push_segment<N>(b.m_cur, b.m_seg->second, sink)) return false;
+      for(const segment* s = b.m_seg + 1; s != e.m_seg; ++s)
+        if(!push_segment<N>(s->first, s->second, sink)) return false;
+      return push_segment<N>(e.m_seg->first, e.m_cur, sink);
+    }
+
+
+   
+
+    const_iterator(const segment* _seg, const segment* _last, const IterT& _cur) :
+      m_seg(_seg), m_last(_last), m_cur(_cur), m_seg_end(_seg->second)
+    {
+      skip();
+    }
+  };
+
+
+  // An empty list gets a single empty segment, so that iterators always have one. That
+  // needs iterators which can be default constructed, as the standard ones can; otherwise
+  // an empty list throws std::invalid_argument.
+  explicit ChainNObject(std::vector<segment> _segments) : m_segments(std::move(_segments)), m_size(0)
+  {
+    if(m_segments.empty()) {
+      if constexpr (std::is_default_constructible<IterT>::value && std::is_default_constructible<SentT>::value)
+        m_segments.emplace_back(IterT(), SentT());
+      else
+        throw std::invalid_argument("Chain: no segments, and no empty one can be made");
+    }
+    if constexpr (is_sized<IterT, SentT>::value)
+      for(const auto& s : m_segments)
+        m_size += _length(s.first, s.second);
+  }
+
+  const_iterator begin() const {
+    const segment* first = m_segments.data();
+    return const_iterator(first, first + m_segments.size() - 1, first->first);
+  }
+
+  auto end() const {
+    const segment* last = m_segments.data() + m_segments.size() - 1;
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(last, last, last->second);
+    else
+      return sentinel();
+  }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value>::type>
+  std::ptrdiff_t size() const {
+    return m_size;
+  }
+};
+
+
+
+
+
+
+
+// Chain also takes two or more ranges with the same iterator types, or a single range of
+// ranges, and returns a ChainNObject over all of them. Only the ranges' iterators are kept,
+// so the ranges must outlive it, and temporaries (which wouldn't) are rejected at compile
+// time: as ranges, or as a range of ranges, or as the ranges it gives.
+template <typename Range>
+using _chain_n_of = ChainNObject<decltype(std::declval<Range&>().begin()), decltype(std::declval<Range&>().end())>;
+
+template <typename Range_1, typename Range_2, typename... Ranges, class = typename std::enable_if<is_range<Range_1>::value>::type>
+_chain_n_of<Range_1> Chain(Range_1&& r_1, Range_2&& r_2, Ranges&&... rs) {
+  static_assert(std::is_lvalue_reference<Range_1>::value && std::is_lvalue_reference<Range_2>::value && (std::is_lvalue_reference<Ranges>::value && ...),
+                "Chain keeps only the ranges' iterators, so it can't take a temporary range: name it first");
+  return _chain_n_of<Range_1>({{r_1.begin(), r_1.end()}, {r_2.begin(), r_2.end()}, {rs.begin(), rs.end()}...});
+}
+
+template <typename Ranges, typename Range = decltype(*std::declval<Ranges&>().begin()), class = typename std::enable_if<is_range<Range>::value>::type>
+_chain_n_of<Range> Chain(Ranges&& rs) {
+  static_assert(std::is_lvalue_reference<Ranges>::value && std::is_lvalue_reference<Range>::value,
+                "Chain keeps only the ranges' iterators, so it can't take a temporary range: name it first");
+  std::vector<typename _chain_n_of<Range>::segment> segments;
+  for(auto&& r : rs)
+    segments.emplace_back(r.begin(), r.end());
+  return _chain_n_of<Range>(std::move(segments));
 }
 
 
@@ -0,0 +1,180 @@
+#ifndef COLLECT_H
+#define COLLECT_H
+
+#include <array>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// Reserving and appending, where the container allows. Overloaded on int/long as in
+// _get_base, so that the first version is preferred when it compiles.
+template <class Container>
+auto _reserve(Container& c, std::ptrdiff_t n, int) -> decltype(c.reserve(n), void()) {
+  c.reserve(n);
+}
+
+template <class Container>
+void _reserve(Container&, std::ptrdiff_t, long) {}
+
+template <class Container, class ValueT>
+auto _append(Container& c, ValueT&& x, int) -> decltype(c.push_back(std::forward<ValueT>(x)), void()) {
+  c.push_back(std::forward<ValueT>(x));
+}
+
+template <class Container, class ValueT>
+void _append(Container& c, ValueT&& x, long) {
+  c.insert(c.end(), std::forward<ValueT>(x));
+}
+
+// Whether a Container can have a whole array of ValueT appended at once.
+template <class Container, class ValueT, class = void>
+struct _takes_blocks : std::false_type {};
+template <class Container, class ValueT>
+struct _takes_blocks<Container, ValueT, decltype(void(std::declval<Container&>().insert(std::declval<Container&>().end(), std::declval<ValueT*>(), std::declval<ValueT*>())))> : std::true_type {};
+
+// The length of an object, if it has a size(), and otherwise that of its iterators, if
+// they are sized (see FIter.h). -1 if neither.
+template <class Range>
+auto _size_of(const Range& r, int) -> decltype(std::ptrdiff_t(r.size())) {
+  return r.size();
+}
+
+template <class Range>
+std::ptrdiff_t _size_of(const Range& r, long) {
+  if constexpr (is_sized<decltype(r.begin()), decltype(r.end())>::value)
+    return r.end() - r.begin();
+  else
+    return -1;
+}
+
+
+// A 'collecting' terminal.
+//
+// Given a pair of iterators, or an object with begin() and end() (such as any of the
+// objects in this library), copies the items into a new container of type Container.
+// Containers are filled with push_back where they have one, and insert at their end
+// otherwise, so sets and the like work too. Items which stages produce by value are moved
+// in.
+//
+// Items are pushed through the stages in one loop, as for ForEach (see _for_each in
+// FIter.h). Trivially copyable, default constructible items go into containers which
+// take ranges at their end (vectors, deques, strings) a block at a time instead (see
+// _for_each_batch, whose buffers need the default constructor), so that stages which work
+// on whole blocks, like Progression's SIMD fill, can.
+//
+// If the length is known up front, because the object has a size() or its iterators are
+// sized, a container with a reserve() has it called exactly once, so the container never
+// grows while being filled.
+//
+// The sequence must end.
+//
+
+// Usage example:
+//
+// std::vector<int> v{0, 1, 2, 3, 4, 5, 6};
+// auto vm = FIter::Map(mod2)(v.begin(), v.end());
+// auto c = FIter::Collect<std::vector<int>>()(vm);
+//
+// c is then the vector {0, 1, 0, 1, 0, 1, 0}, allocated once.
+
+template <typename Container>
+struct Collect {
+ public:
+
+  template <typename IterT, typename SentT>
+  Container operator() (IterT start, SentT end) const {
+    Container c;
+    if constexpr (is_sized<IterT, SentT>::value)
+      _reserve(c, end - start, 0);
+    fill(c, start, end);
+    return c;
+  }
+
+  template <typename Range>
+  Container operator() (const Range& r) const {
+    Container c;
+    std::ptrdiff_t n = _size_of(r, 0);
+    if(n >= 0)
+      _reserve(c, n, 0);
+    fill(c, r.begin(), r.end());
+    return c;
+  }
+
+ private:
+  template <typename IterT, typename SentT>
+  static void fill(Container& c, const IterT& start, const SentT& end) {
+    FITER_TRACE("Collect");
+    typedef typename std::decay<decltype(*start)>::type value_type;
+    if constexpr (std::is_trivially_copyable<value_type>::value && std::is_default_constructible<value_type>::value && _takes_blocks<Container, value_type>::value)
+      _for_each_batch<default_batch_size>(start, end, [&c](value_type* items, std::size_t n) { c.insert(c.end(), items, items + n); return true; });
+    else
+      _for_each(start, end, [&c](auto&& x) { _append(c, std::forward<decltype(x)>(x), 0); return true; });
+  }
+};
+
+
+
+
+
+
+
+// Collecting into a std::array<T, N> instead: the first N items are copied in, in order.
+// Items past the Nth are never reached, so the sequence needn't end; if it has fewer than
+// N items, std::length_error is thrown.
+//
+// Unlike the general version, this pulls items through the iterators rather than pushing
+// them, and is constexpr, as are Progression, Map, Filter, Take and Zip (and '|', in
+// Pipe.h, except where it makes a MapFilter): so tables can be worked out at compile time
+// and built into the binary, by the same code which would otherwise build them at startup.
+// In a constant expression, too few items is a compile error.
+//
+
+// Usage example:
+//
+// constexpr auto squares = FIter::Collect<std::array<int, 16>>()(FIter::Progression(0) | FIter::Map(square));
+// static_assert(squares[15] == 225);
+//
+// squares is then worked out by the compiler, assuming 'square' is constexpr (as lambdas
+// are, where they can be).
+
+template <typename T, std::size_t N>
+struct Collect<std::array<T, N>> {
+ public:
+
+  template <typename IterT, typename SentT>
+  constexpr std::array<T, N> operator() (IterT start, SentT end) const {
+    return fill(start, end, std::make_index_sequence<N>());
+  }
+
+  template <typename Range>
+  constexpr std::array<T, N> operator() (const Range& r) const {
+    return fill(r.begin(), r.end(), std::make_index_sequence<N>());
+  }
+
+ private:
+  // The items are the array's initializers, which are worked out in order. So nothing is
+  // assigned, which T needn't support in a constant expression (std::pair doesn't).
+  template <typename IterT, typename SentT, std::size_t... I>
+  static constexpr std::array<T, N> fill(IterT it, const SentT& end, std::index_sequence<I...>) {
+    return {{item(it, end, I)...}};
+  }
+
+  // Item i, where it is at item i-1 (the first stays put, so nothing is looked for past
+  // the last).
+  template <typename IterT, typename SentT>
+  static constexpr T item(IterT& it, const SentT& end, std::size_t i) {
+    if(i > 0) ++it;
+    if(it == end)
+      throw std::length_error("Collect: fewer items than the array holds");
+    return *it;
+  }
+};
+
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+namespace FIter {
+
+
+// Comparison predicates.
+//
+// Callable objects comparing an item against a fixed value, for use with Filter,
+// TakeWhile and so on, as in 'FIter::Filter(FIter::Less(100))'. They behave exactly like
+// the lambdas one would write instead, but their type says what they do, so stages can
+// recognise them: a Filter over a vector of int, float or double with a comparison against
+// a value of the same type compacts with SIMD instructions (see Simd.h).
+//
+// The item is on the left: Less(100) is true of items less than 100.
+//
+
+enum class Cmp { lt, le, gt, ge, eq, ne };
+
+template <Cmp op, typename T>
+struct Compare {
+  T value;
+
+  constexpr bool operator()(const T& x) const {
+    switch(op) {
+      case Cmp::lt: return x < value;
+      case Cmp::le: return x <= value;
+      case Cmp::gt: return x > value;
+      case Cmp::ge: return x >= value;
+      case Cmp::eq: return x == value;
+      case Cmp::ne: return x != value;
+    }
+    return false;
+  }
+};
+
+template <typename T> constexpr Compare<Cmp::lt, T> Less(T value) { return {value}; }
+template <typename T> constexpr Compare<Cmp::le, T> LessEqual(T value) { return {value}; }
+template <typename T> constexpr Compare<Cmp::gt, T> Greater(T value) { return {value}; }
+template <typename T> constexpr Compare<Cmp::ge, T> GreaterEqual(T value) { return {value}; }
+template <typename T> constexpr Compare<Cmp::eq, T> Equal(T value) { return {value}; }
+template <typename T> constexpr Compare<Cmp::ne, T> NotEqual(T value) { return {value}; }
+
+
+
+}
+
+#endif
@@ -12,11 +12,18 @@ namespace FIter {
 //
 // The point of this file. Given a pair of iterators of type IterT and a positive integer,
 // it can create forward iterators (a nested subtype) from the passed pair. However, these
-// created iterators begin after the given number of elements.
+// created iterators begin after the given number of elements. If the original iterators
+// are random access, so are these, and skipping the elements takes constant time.
 //
 // If you ask for more items than you supply, return an empty iterator (that is,
 // begin()==end()).
 //
+// The end of the pair may be a sentinel of type SentT instead. end() is a const_iterator
+// when SentT is IterT, an Unreachable when SentT is, and otherwise a sentinel wrapping the
+// original one.
+//
+// If the original pair is sized (see FIter.h), so is this one, and size() is defined.
+//
 // Create using Drop(), below.
 //
 
@@ -29,24 +36,29 @@ namespace FIter {
 // 
 // This will print '3,4,5,6,'.
 
-template<typename IterT>
+template<typename IterT, typename SentT = IterT>
 class DropObject {
 
-  typedef typename IterT::value_type value_type;
-  // Note: The following is necessary because DropObjects never support reverse iteration.
-  typedef typename least_iterator_type<typename IterT::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+  typedef typename std::iterator_traits<IterT>::value_type value_type;
+  // Note: The following is necessary because DropObjects only support reverse iteration
+  // as part of random access.
+  typedef typename random_or_forward<typename std::iterator_traits<IterT>::iterator_category>::type least_common_subtype;
 
  protected:
   const IterT m_begin;
-  const IterT m_end;
+  const SentT m_end;
  
   const long to_drop;
 
 
  public:
+  struct sentinel {
+    SentT m_end;
+  };
+
  	// Actually one of the simplest types; doesn't even need its own type, really, because
  	// we could just use the parent. Included for completeness, though.
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
   public Iterator_base<least_common_subtype, const_iterator, value_type>
   {
     IterT m_cur;
@@ -64,6 +76,42 @@ class DropObject {
     void advance() {
 			++m_cur;
     }
+
+    void unadvance() {
+			--m_cur;
+    }
+
+    void advance(std::ptrdiff_t n) {
+			m_cur += n;
+    }
+
+    std::ptrdiff_t distance_from(const const_iterator& r) const {
+      return m_cur - r.m_cur;
+    }
+
+    bool reached(const sentinel& s) const {
+      return m_cur == s.m_end;
+    }
+
+    template <class S = SentT>
+    auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t(std::declval<const S&>() - m_cur)) {
+      return s.m_end - m_cur;
+    }
+
+    // Internal iteration: see _for_each in FIter.h.
+    static const IterT& end_of(const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const sentinel& e) { return e.m_end; }
+    static Unreachable end_of(Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      return _for_each(b.m_cur, end_of(e), sink);
+    }
+
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      return _for_each_batch<N>(b.m_cur, end_of(e), sink);
+    }
     
     const_iterator(const IterT & _cur) : m_cur(_cur)
     {} 
@@ -76,20 +124,28 @@ class DropObject {
   };
   
 
-  DropObject(IterT _begin, IterT _end, long _to_drop) : m_begin(_begin), m_end(_end), to_drop(_to_drop)
+  DropObject(IterT _begin, SentT _end, long _to_drop) : m_begin(_begin), m_end(_end), to_drop(_to_drop)
   {}
    
-  const_iterator begin() const {
-  	auto t_advanced = m_begin;
-  	for(long i=0; i<to_drop && t_advanced != m_end; i++) {
-  		++t_advanced;
-  	}
-    return const_iterator(t_advanced);
+  const_iterator begin() const { // See FIter.h for _advance_within.
+    return const_iterator(_advance_within(m_begin, m_end, to_drop));
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end);
+  auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel{m_end};
   }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value>::type>
+  std::ptrdiff_t size() const { // See FIter.h for _length.
+    return std::max<std::ptrdiff_t>(_length(m_begin, m_end) - std::max(to_drop, 0L), 0);
+  }
+
+  friend struct Fusion; // see Pipe.h
 };
 
 
@@ -107,9 +163,9 @@ class Drop {
   
   Drop(long _n) : n(_n) {}
   
-  template <typename IterT>
-  DropObject<IterT> operator() (IterT start, IterT end) {
-    return DropObject<IterT>(start, end, n);
+  template <typename IterT, typename SentT>
+  DropObject<IterT, SentT> operator() (IterT start, SentT end) {
+    return DropObject<IterT, SentT>(start, end, n);
   }
 };
 
@@ -1,9 +1,11 @@
 #ifndef DROPWHILE_H
 #define DROPWHILE_H
 
-#include <functional>
 #include <iterator>
+#include <type_traits>
 #include "FIter.h"
+#include "Drop.h"
+#include "Sorted.h"
 
 namespace FIter {
 
@@ -18,6 +20,16 @@ namespace FIter {
 // If every element passes the predicate function, returns an empty iterator (that is,
 // begin()==end()).
 //
+// The end of the pair may be a sentinel of type SentT instead. end() is a const_iterator
+// when SentT is IterT, an Unreachable when SentT is, and otherwise a sentinel wrapping the
+// original one.
+//
+// With a predicate wrapped in Sorted() (see Sorted.h), over random access iterators ending
+// in iterators or not ending, DropWhile() finds the first item to fail by binary search
+// up front, and returns a DropObject dropping the items before it instead.
+//
+// As for Map and Filter, the function must be callable as const.
+//
 // Create using DropWhile(), below.
 //
 
@@ -30,24 +42,28 @@ namespace FIter {
 // 
 // This will print '3,4,5,6,'.
 
-template<typename IterT>
-class DropWhileObject {
+template<typename IterT, typename func, typename SentT = IterT>
+class DropWhileObject : protected Function_base<func> {
+  static_assert(std::is_invocable<const func&, decltype(*std::declval<const IterT&>())>::value,
+                "DropWhile's function must be callable as const: a mutable lambda isn't");
 
-  typedef typename IterT::value_type value_type;
+  typedef typename std::iterator_traits<IterT>::value_type value_type;
   // Note: The following is necessary because DropWhileObjects never support reverse iteration.
-  typedef typename least_iterator_type<typename IterT::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT>::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
 
  protected:
   const IterT m_begin;
-  const IterT m_end;
- 
-  std::function<bool(value_type)> whilef;
+  const SentT m_end;
 
 
  public:
+  struct sentinel {
+    SentT m_end;
+  };
+
  	// Actually one of the simplest types; doesn't even need its own type, really, because
  	// we could just use the parent. Included for completeness, though.
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
   public Iterator_base<least_common_subtype, const_iterator, value_type>
   {
     IterT m_cur;
@@ -66,6 +82,30 @@ class DropWhileObject {
 			++m_cur;
     }
 
+    bool reached(const sentinel& s) const {
+      return m_cur == s.m_end;
+    }
+
+    template <class S = SentT>
+    auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t(std::declval<const S&>() - m_cur)) {
+      return s.m_end - m_cur;
+    }
+
+    // Internal iteration: see _for_each in FIter.h.
+    static const IterT& end_of(const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const sentinel& e) { return e.m_end; }
+    static Unreachable end_of(Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      return _for_each(b.m_cur, end_of(e), sink);
+    }
+
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      return _for_each_batch<N>(b.m_cur, end_of(e), sink);
+    }
+
     const_iterator(const IterT & _cur) : m_cur(_cur)
     {} 
 
@@ -77,19 +117,25 @@ class DropWhileObject {
   };
   
 
-  DropWhileObject(IterT _begin, IterT _end, std::function<bool(value_type)> _whilef) : m_begin(_begin), m_end(_end), whilef(_whilef)
+  DropWhileObject(IterT _begin, SentT _end, func _whilef) : Function_base<func>(_whilef), m_begin(_begin), m_end(_end)
   {}
    
   const_iterator begin() const {
+  	const func& whilef = this->fn();
   	auto t_advanced = m_begin;
-  	while(whilef(*t_advanced) && t_advanced != m_end) {
+  	while(t_advanced != m_end && whilef(*t_advanced)) {
   		++t_advanced;
   	}
     return const_iterator(t_advanced);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end);
+  auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel{m_end};
   }
 };
 
@@ -100,8 +146,10 @@ class DropWhileObject {
 
 
 // Stores a boolean function f. When called on a pair of iterators, returns a
-// DropWhileObject which iterates between them starting when f(item) is first false.
-// 'func' is 'std::function<bool, ValueT>', in this case.
+// DropWhileObject which iterates between them starting when f(item) is first false, or,
+// for Sorted(f) where the items can be searched, a DropObject dropping the items before
+// that.
+// 'func' is any type callable as 'bool(ValueT)', in this case.
 // Its purposes are to allow currying and implicit template instantiation.
 template <typename func>
 class DropWhileOn {
@@ -110,9 +158,12 @@ class DropWhileOn {
   
   DropWhileOn(func _f) : f(_f) {}
   
-  template <typename IterT>
-  DropWhileObject<IterT> operator() (IterT start, IterT end) {
-    return DropWhileObject<IterT>(start, end, f);
+  template <typename IterT, typename SentT>
+  auto operator() (IterT start, SentT end) {
+    if constexpr (is_monotone<func>::value && is_jumpable<IterT, SentT>::value) // See Sorted.h.
+      return DropObject<IterT, SentT>(start, end, _partition_point(start, end, f) - start);
+    else
+      return DropWhileObject<IterT, func, SentT>(start, end, f);
   }
 };
 
@@ -122,16 +173,10 @@ class DropWhileOn {
 
 // DropWhile takes a boolean function and returns a DropWhileOn<> storing that function.
 // Only necessary to allow implicit template instantiation and lambdas.
-// Two versions: this for callable objects, the next for function pointers.
+// Callable objects are stored as they are; functions decay to function pointers.
 template<typename F>
-auto DropWhile(F f) -> DropWhileOn<std::function<bool(typename function_traits<decltype(&F::operator())>::arg_type)> >
-{
-  return DropWhileOn<std::function<bool(typename function_traits<decltype(&F::operator())>::arg_type)>>(f);
-}
-
-template<typename A>
-DropWhileOn<std::function<bool(A)>> DropWhile(bool(&f)(A)) {
-  return DropWhileOn<std::function<bool(A)>>(f);
+DropWhileOn<F> DropWhile(F f) {
+  return DropWhileOn<F>(f);
 }
 
 
@@ -1,8 +1,14 @@
 #ifndef FITER_FITER_H
 #define FITER_FITER_H
 
-#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "Trace.h"
 
 namespace FIter {
 
@@ -35,27 +41,185 @@ template <> struct least_iterator_type<std::random_access_iterator_tag, std::ran
 
 
 
+// The category of a stage which can jump about when its source can, but otherwise only
+// goes forward.
+template <class Tag>
+struct random_or_forward {typedef typename least_iterator_type<Tag, std::forward_iterator_tag>::type type;};
+template <> struct random_or_forward<std::random_access_iterator_tag> {typedef std::random_access_iterator_tag type;};
+
+template <class IterT>
+struct is_random_access : std::is_same<typename std::iterator_traits<IterT>::iterator_category, std::random_access_iterator_tag> {};
+
+// Whether T is a range (has begin()) rather than an iterator, for the builders which take
+// either.
+template <class T, class = void>
+struct is_range : std::false_type {};
+template <class T>
+struct is_range<T, decltype(void(std::declval<T&>().begin()))> : std::true_type {};
+
+// Whether T owns the items its iterators point into, so that they dangle once a temporary
+// T is gone: the standard containers (which all have a size_type), and the FIter sources
+// which say so with 'typedef void owns_items;' (MmapRange, LineReader, ChainNObject).
+template <class T, class = void>
+struct _has_size_type : std::false_type {};
+template <class T>
+struct _has_size_type<T, decltype(void(std::declval<typename T::size_type>()))> : std::true_type {};
+
+template <class T, class = void>
+struct owns_items : _has_size_type<T> {};
+template <class T>
+struct owns_items<T, decltype(void(std::declval<typename T::owns_items*>()))> : std::true_type {};
+
+
+
+
+
+
+
+// The member types std::iterator_traits looks for. Stands in for std::iterator, which is
+// deprecated as of C++17.
+template <class Tag, class T>
+struct Iterator_types {
+  typedef Tag iterator_category;
+  typedef T value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef T* pointer;
+  typedef T& reference;
+};
+
+
+
+
+
+
+
+// The end of a sequence which never ends, such as a Progression. Nothing is ever equal to
+// it, and the compiler can see as much, so loops bounded by it have no exit test at all.
+// Stages over a sequence ending in an Unreachable are just as endless, and end in one too.
+struct Unreachable {
+  template <class IterT>
+  friend constexpr bool operator==(const IterT&, Unreachable) { return false; }
+  template <class IterT>
+  friend constexpr bool operator==(Unreachable, const IterT&) { return false; }
+  template <class IterT>
+  friend constexpr bool operator!=(const IterT&, Unreachable) { return true; }
+  template <class IterT>
+  friend constexpr bool operator!=(Unreachable, const IterT&) { return true; }
+};
+
+
+
+
+
+
+
+// Whether the distance from an iterator of type IterT to an end of type SentT can be found
+// in constant time, by subtraction. That's so for random access iterators ending in
+// iterators, and for FIter objects whose sources are sized and whose own length follows
+// from theirs (whose iterators support 'end - it' through remaining(), below).
+template <class IterT, class SentT, class = void>
+struct is_sized : std::false_type {};
+template <class IterT, class SentT>
+struct is_sized<IterT, SentT, decltype(void(std::declval<const SentT&>() - std::declval<const IterT&>()))> : std::true_type {};
+
+// Whether an iterator of type IterT can jump straight to any place before an end of type
+// SentT: it must be random access, and either sized or endless.
+template <class IterT, class SentT>
+struct is_jumpable : std::integral_constant<bool, is_random_access<IterT>::value && (std::is_same<IterT, SentT>::value || std::is_same<SentT, Unreachable>::value)> {};
+
+// The number of places from an iterator to the end, for sized iterators. Endless sequences
+// are as long as anything can be.
+template <class IterT, class SentT>
+constexpr auto _length(const IterT& it, const SentT& end) -> decltype(std::ptrdiff_t(end - it)) {
+  return end - it;
+}
+
+template <class IterT>
+constexpr std::ptrdiff_t _length(const IterT&, Unreachable) {
+  return PTRDIFF_MAX;
+}
+
+// Advances an iterator n places, or to the end if that comes first. Takes constant time
+// when the distance to the end is known, or when there is no end and the iterator is
+// random access.
+template <class IterT, class SentT>
+constexpr IterT _advance_within(IterT it, const SentT& end, long n) {
+  if(n < 0) n = 0;
+  if constexpr (is_jumpable<IterT, SentT>::value) {
+    return it + std::min<std::ptrdiff_t>(n, _length(it, end));
+  }
+  else {
+    for(long i=0; i<n && it != end; ++i) ++it;
+    return it;
+  }
+}
+
+
+
+
+
+
+
 // Base classes from which to inherit most functionality (++, etc). Overload as needed.
 // By specifying the type of iterator, only those functions that type supports will be
 // defined.
 // In order to inherit from this base class, a class must supply, at least, an m_cur 
 // member and access() and advance() methods, as well as unadvance() if the class supports
-// backwards iteration. If the class supports random access it must support access(n).
+// backwards iteration. If the class supports random access it must support advance(n),
+// moving n places in either direction, and distance_from(r), the number of places from
+// r to it.
+// The bases hold no state of their own (they reach the derived iterator by casting
+// 'this'), so an iterator is exactly as large as the members it declares.
+// Everything here is constexpr, so iterators whose own members are can be used in
+// constant expressions.
+//
+// Iterators are compared with each other through m_cur. Objects whose end() returns a
+// sentinel rather than an iterator give their iterators a reached(sentinel) method, and
+// the comparisons between the two (both ways round) are defined here in terms of it.
+// Likewise, iterators which know how far they are from a sentinel have a remaining(sentinel)
+// method, and 'sentinel - iterator' is defined in terms of that. It must only be declared
+// when it can be computed, so that is_sized can tell.
 template <class Tag, class IterT, class value_type>
 class Iterator_base;
 
+// Whether iterators of type IterT can be compared to sentinels of type SentT.
+template <class IterT, class SentT, class = void>
+struct has_reached : std::false_type {};
+template <class IterT, class SentT>
+struct has_reached<IterT, SentT, decltype(void(std::declval<const IterT&>().reached(std::declval<const SentT&>())))> : std::true_type {};
+
+// Whether iterators of type IterT know how far they are from sentinels of type SentT.
+template <class IterT, class SentT, class = void>
+struct has_remaining : std::false_type {};
+template <class IterT, class SentT>
+struct has_remaining<IterT, SentT, decltype(void(std::declval<const IterT&>().remaining(std::declval<const SentT&>())))> : std::true_type {};
+
 template <class IterT, class value_type> // input iterator
 class Iterator_base<std::input_iterator_tag, IterT, value_type> {
- private:
-	IterT* parent;
+ protected:
+  constexpr IterT& self() { return static_cast<IterT&>(*this); }
+  constexpr const IterT& self() const { return static_cast<const IterT&>(*this); }
  public:
-  Iterator_base() { parent = static_cast<IterT*>(this); }
-	IterT& operator++() { parent->advance(); return *parent; }
-	IterT operator++(int) { auto tmp = *parent; parent->advance(); return tmp;}  
-  value_type operator*() const { return parent->access(); }  
-  value_type* operator->() const { return &(parent->access()); }
-  bool operator==(const IterT& r) const { return (parent->m_cur == r.m_cur); }
-  bool operator!=(const IterT& r) const { return !(parent->operator==(r)); }
+	constexpr IterT& operator++() { self().advance(); return self(); }
+	constexpr IterT operator++(int) { IterT tmp = self(); self().advance(); return tmp;}  
+  constexpr value_type operator*() const { return self().access(); }  
+  constexpr value_type* operator->() const { return &(self().access()); }
+  constexpr bool operator==(const IterT& r) const { return (self().m_cur == r.m_cur); }
+  constexpr bool operator!=(const IterT& r) const { return !(self().operator==(r)); }
+
+  // These are friends, rather than members, so that iterators which define their own
+  // operator== don't hide them.
+  template <class SentT, class = typename std::enable_if<has_reached<IterT, SentT>::value>::type>
+  friend constexpr bool operator==(const IterT& i, const SentT& s) { return i.reached(s); }
+  template <class SentT, class = typename std::enable_if<has_reached<IterT, SentT>::value>::type>
+  friend constexpr bool operator!=(const IterT& i, const SentT& s) { return !i.reached(s); }
+  template <class SentT, class = typename std::enable_if<has_reached<IterT, SentT>::value>::type>
+  friend constexpr bool operator==(const SentT& s, const IterT& i) { return i.reached(s); }
+  template <class SentT, class = typename std::enable_if<has_reached<IterT, SentT>::value>::type>
+  friend constexpr bool operator!=(const SentT& s, const IterT& i) { return !i.reached(s); }
+
+  template <class SentT, class = typename std::enable_if<has_remaining<IterT, SentT>::value>::type>
+  friend constexpr std::ptrdiff_t operator-(const SentT& s, const IterT& i) { return i.remaining(s); }
 };
 
 // This provides nothing additional, but inherits from input_iterator
@@ -65,30 +229,25 @@ class Iterator_base<std::forward_iterator_tag, IterT, value_type> : public Itera
 
 template <class IterT, class value_type> // bidirectional iterator
 class Iterator_base<std::bidirectional_iterator_tag, IterT, value_type> : public Iterator_base<std::input_iterator_tag, IterT, value_type> {
- private:
-	IterT* parent;
  public:
-  Iterator_base() { parent = static_cast<IterT*>(this); }
-	IterT& operator--() { parent->unadvance(); return *parent; }
-	IterT operator--(int) { auto tmp = *parent; parent->unadvance(); return tmp; }  
+	constexpr IterT& operator--() { this->self().unadvance(); return this->self(); }
+	constexpr IterT operator--(int) { IterT tmp = this->self(); this->self().unadvance(); return tmp; }  
 };
 
 template <class IterT, class value_type> // random access iterator
 class Iterator_base<std::random_access_iterator_tag, IterT, value_type> : public Iterator_base<std::bidirectional_iterator_tag, IterT, value_type> {
- private:
-	IterT* parent;
  public:
-  Iterator_base() { parent = static_cast<IterT*>(this); }
-  //typedef typename IterT::difference_type difference_type; // strictly speaking the below 'n's should be of type difference_type, but gcc complains
-	IterT& operator+=(int n) { parent->m_cur += n; return *parent; }
-	IterT operator+(int n) { auto tmp = *parent; tmp+=n; return tmp; }
-	IterT& operator-=(int n) { parent->m_cur -= n; return *parent; }
-	IterT operator-(int n) { auto tmp = *parent; tmp-=n; return tmp; }
-	value_type operator[](int n) { return *(*parent+n); }
-	bool operator<(const IterT& r) { return (parent->m_cur) < r.m_cur; }
-	bool operator<=(const IterT& r) { return (parent->m_cur) <= r.m_cur; }
-	bool operator>(const IterT& r) { return (parent->m_cur) > r.m_cur; }
-	bool operator>=(const IterT& r) { return (parent->m_cur) >= r.m_cur; }
+	constexpr IterT& operator+=(std::ptrdiff_t n) { this->self().advance(n); return this->self(); }
+	constexpr IterT operator+(std::ptrdiff_t n) const { IterT tmp = this->self(); tmp+=n; return tmp; }
+	friend constexpr IterT operator+(std::ptrdiff_t n, const IterT& r) { return r+n; }
+	constexpr IterT& operator-=(std::ptrdiff_t n) { this->self().advance(-n); return this->self(); }
+	constexpr IterT operator-(std::ptrdiff_t n) const { IterT tmp = this->self(); tmp-=n; return tmp; }
+	constexpr std::ptrdiff_t operator-(const IterT& r) const { return this->self().distance_from(r); }
+	constexpr value_type operator[](std::ptrdiff_t n) const { return *(this->self()+n); }
+	constexpr bool operator<(const IterT& r) const { return this->self().distance_from(r) < 0; }
+	constexpr bool operator<=(const IterT& r) const { return this->self().distance_from(r) <= 0; }
+	constexpr bool operator>(const IterT& r) const { return this->self().distance_from(r) > 0; }
+	constexpr bool operator>=(const IterT& r) const { return this->self().distance_from(r) >= 0; }
 };
 
 
@@ -115,26 +274,196 @@ IterT _get_base(IterT parent, long) {
 
 
 
-// Used to provide the argument and return types of a unary function at compile time.
-// Technique from Xeo:
-// http://stackoverflow.com/a/8712212/1644272
-template<class FPtr>
-struct function_traits;
-template<class R, class C, class A>
-struct function_traits<R (C::*)(A)>
-{   // non-const specialization
-    typedef A arg_type;
-    typedef R result_type;
+// Pushes every item from begin up to end into sink, a callable taking an item and
+// returning false to stop early. Returns false if the sink stopped it, and true if the
+// items ran out.
+//
+// Iterators which wrap others may define a static push(begin, end, sink), which passes
+// their own items on by pushing the wrapped iterators' items through a sink of their own.
+// Nested stages then become a single loop over the innermost iterators, with each stage's
+// work inlined into the body, rather than a loop over the outermost ones in which every
+// increment and comparison goes all the way down. Otherwise this is a plain loop.
+// (Same overloading technique as _get_base.)
+template <class IterT, class SentT, class Sink>
+auto _push(const IterT& begin, const SentT& end, Sink&& sink, int) -> decltype(IterT::push(begin, end, sink)) {
+  return IterT::push(begin, end, sink);
+}
+
+template <class IterT, class SentT, class Sink>
+bool _push(IterT begin, const SentT& end, Sink&& sink, long) {
+  for(; begin != end; ++begin)
+    if(!sink(*begin)) return false;
+  return true;
+}
+
+template <class IterT, class SentT, class Sink>
+bool _for_each(const IterT& begin, const SentT& end, Sink&& sink) {
+  return _push(begin, end, sink, 0);
+}
+
+
+
+
+
+
+
+// The same, a block at a time. The sink is called as sink(items, n), where items points to
+// a buffer of n (at most N, never 0) items which it may modify in any way, and returns
+// false to stop early.
+//
+// Iterators may define a static push_batch<N>(begin, end, sink) to pass on the blocks of
+// the iterators they wrap, working on a whole block at once: Map transforms it, Filter
+// compacts it, Take cuts it short, and so on. Otherwise items are copied into a buffer on
+// the stack; items which can't be default constructed (so can't be kept in one) are passed
+// on in blocks of one, as are those of stages which make blocks of their own.
+const std::size_t default_batch_size = 256;
+
+// Calls body(i) for each i in [0, n), in runs of 8 of fixed length, for loops over a block
+// (in stages, and in functions given to ForEachBatch): compilers vectorise those where
+// they won't a loop of unknown length (GCC at -O2).
+template <class Body>
+inline void for_block(std::size_t n, Body&& body) {
+  std::size_t i = 0;
+  for(; i + 8 <= n; i += 8)
+    for(std::size_t j = 0; j < 8; ++j)
+      body(i + j);
+  for(; i < n; ++i)
+    body(i);
+}
+
+template <std::size_t N, class IterT, class SentT, class Sink>
+auto _push_batch(const IterT& begin, const SentT& end, Sink&& sink, int) -> decltype(IterT::template push_batch<N>(begin, end, sink)) {
+  return IterT::template push_batch<N>(begin, end, sink);
+}
+
+template <std::size_t N, class IterT, class SentT, class Sink>
+bool _push_batch(IterT begin, const SentT& end, Sink&& sink, long) {
+  typedef typename std::decay<decltype(*begin)>::type value_type;
+  if constexpr (!std::is_default_constructible<value_type>::value) {
+    return _for_each(begin, end, [&sink](auto&& x) {
+      value_type item(std::forward<decltype(x)>(x));
+      return sink(&item, 1);
+    });
+  }
+  else if constexpr (is_jumpable<IterT, SentT>::value) { // copy whole blocks with no end checks
+    value_type items[N];
+    for(std::ptrdiff_t left = _length(begin, end); left > 0; ) {
+      std::size_t n = std::min<std::ptrdiff_t>(left, N);
+      for_block(n, [&](std::size_t i) { items[i] = begin[i]; });
+      if(!sink(items, n)) return false;
+      left -= n;
+      begin += n; // not N, which would pass the end
+    }
+  }
+  else {
+    value_type items[N];
+    while(begin != end) {
+      std::size_t n = 0;
+      for(; n < N && begin != end; ++begin)
+        items[n++] = *begin;
+      if(!sink(items, n)) return false;
+    }
+  }
+  return true;
+}
+
+template <std::size_t N, class IterT, class SentT, class Sink>
+bool _for_each_batch(const IterT& begin, const SentT& end, Sink&& sink) {
+  return _push_batch<N>(begin, end, sink, 0);
+}
+
+
+
+
+
+
+
+// Splitting a sequence into pieces by position, for the Parallel terminals.
+// _slice_length(begin, end) is the number of positions in a sequence, and
+// _slice(begin, end, lo, hi) is a pair of iterators of the same types over just the items
+// coming from positions lo to hi, so that the pieces of a split are in order and together
+// hold exactly the items of the whole.
+//
+// For random access iterators ending in the same type, positions are items. Iterators
+// which wrap others and can't jump about themselves, like Filter's, may define static
+// slice_length and slice functions giving the positions of the iterators they wrap.
+template <class IterT, class SentT>
+auto _slice_length(const IterT& begin, const SentT& end, int) -> decltype(IterT::slice_length(begin, end)) {
+  return IterT::slice_length(begin, end);
+}
+
+template <class IterT, class = typename std::enable_if<is_random_access<IterT>::value>::type>
+std::ptrdiff_t _slice_length(const IterT& begin, const IterT& end, long) {
+  return end - begin;
+}
+
+template <class IterT, class SentT>
+auto _slice(const IterT& begin, const SentT& end, std::ptrdiff_t lo, std::ptrdiff_t hi, int) -> decltype(IterT::slice(begin, end, lo, hi)) {
+  return IterT::slice(begin, end, lo, hi);
+}
+
+template <class IterT, class = typename std::enable_if<is_random_access<IterT>::value>::type>
+std::pair<IterT, IterT> _slice(const IterT& begin, const IterT&, std::ptrdiff_t lo, std::ptrdiff_t hi, long) {
+  return std::make_pair(begin + lo, begin + hi);
+}
+
+// Whether a pair of iterators of types IterT and SentT can be split as above.
+template <class IterT, class SentT, class = void>
+struct is_sliceable : std::false_type {};
+template <class IterT, class SentT>
+struct is_sliceable<IterT, SentT, decltype(void(_slice_length(std::declval<const IterT&>(), std::declval<const SentT&>(), 0)))> : std::true_type {};
+
+
+
+
+
+
+
+// Stores the callable of a Map, Filter, etc. for an iterator or object which inherits from
+// it, keeping its exact type so that calls can be inlined. Stateless callables (such as
+// captureless lambdas) are kept as an empty base class, and so take up no space at all;
+// anything else (function pointers, capturing lambdas) is kept as a member.
+// Lambdas can be copied but not assigned, so assignment rebuilds the stored copy in place.
+// fn() gives only const access, since iterators are dereferenced through const members
+// and copied freely (so state kept in the callable would be split between the copies):
+// callables must be callable as const, which mutable lambdas aren't.
+// (Except in constant expressions, which can't: iterators over such lambdas can be copied
+// there, but not assigned.)
+template <class F, bool = std::is_empty<F>::value && !std::is_final<F>::value>
+class Function_base;
+
+template <class F> // stateful callable
+class Function_base<F, false> {
+ private:
+  F m_f;
+
+  constexpr void assign(const F& f, std::true_type) { m_f = f; }
+  void assign(const F& f, std::false_type) { m_f.~F(); new (&m_f) F(f); }
+
+ public:
+  constexpr Function_base(const F& _f) : m_f(_f) {}
+  constexpr Function_base(const Function_base& r) : m_f(r.m_f) {}
+  constexpr Function_base& operator=(const Function_base& r) {
+    if(this != &r) assign(r.m_f, typename std::is_copy_assignable<F>::type());
+    return *this;
+  }
+
+  constexpr const F& fn() const { return m_f; }
 };
-template<class R, class C, class A>
-struct function_traits<R (C::*)(A) const>
-{   // const specialization
-    typedef A arg_type;
-    typedef R result_type;
+
+template <class F> // stateless callable
+class Function_base<F, true> : private F {
+ public:
+  constexpr Function_base(const F& _f) : F(_f) {}
+  constexpr Function_base(const Function_base& r) : F(r.fn()) {}
+  constexpr Function_base& operator=(const Function_base&) { return *this; } // nothing to copy
+
+  constexpr const F& fn() const { return *this; }
 };
 
 
 
 
+
 }
 #endif
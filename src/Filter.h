@@ -1,9 +1,10 @@
 #ifndef FILTER_H
 #define FILTER_H
 
-#include <functional>
 #include <iterator>
+#include <type_traits>
 #include "FIter.h"
+#include "Simd.h"
 
 namespace FIter {
 
@@ -14,6 +15,19 @@ namespace FIter {
 // it can create forward iterators (a nested subtype) from the passed pair. However, these
 // iterators will skip over those elements for which the given function returns false.
 //
+// The end of the pair may be a sentinel of type SentT instead. end() is a const_iterator
+// when SentT is IterT (an end iterator costs no more than a sentinel here, since it never
+// calls the function), an Unreachable when SentT is, and otherwise an empty sentinel.
+//
+// Over a vector (or array) of 32 bit ints, floats or doubles, with a comparison from
+// Compare.h against a value of the same type, items are tested several at a time with
+// SIMD instructions where the CPU has them (see Simd.h): iterators skip ahead to the next
+// passing item without a branch per item, and ForEach and the like compact whole blocks.
+// The results are the same either way.
+//
+// The function is only ever called as const (as are Map's), so a lambda marked 'mutable',
+// or an object whose operator() isn't const, won't compile.
+//
 // Create using Filter(), below.
 //
 
@@ -27,28 +41,33 @@ namespace FIter {
 // This will print '0,2,4,6,', assuming 'mod2' is defined appropriately. (Say, as
 // 'bool mod2(int x){return x%2==0;}'.
 
-template<typename IterT>
+template<typename IterT, typename func, typename SentT = IterT>
 class FilteredObject {
+  static_assert(std::is_invocable<const func&, decltype(*std::declval<const IterT&>())>::value,
+                "Filter's function must be callable as const: a mutable lambda isn't");
 
-  typedef typename IterT::value_type value_type;
+  typedef typename std::iterator_traits<IterT>::value_type value_type;
   // Note: The following is necessary because Filters never support reverse iteration.
-  typedef typename least_iterator_type<typename IterT::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT>::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
 
  protected:
   const IterT m_begin;
-  const IterT m_end;
+  const SentT m_end;
  
-  std::function<bool(value_type)> filter;
+  func filter;
 
 
  public:
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
-  public Iterator_base<least_common_subtype, const_iterator, value_type>
+  // Iterators know their own end, so the sentinel needs nothing.
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
+  public Iterator_base<least_common_subtype, const_iterator, value_type>,
+  public Function_base<func>
   {
     // Normally we don't store end, but filter uses them for skipping safely.
     IterT m_cur;
-    IterT m_end;
-    std::function<bool(value_type)> filter;
+    SentT m_end;
 
     // Get the iterator at the base of a chain of FIters. For example, if you apply a
     // filter to a vector, and then a map to the filter, calling this on the map will
@@ -58,43 +77,158 @@ class FilteredObject {
       return _get_base<IterT>(m_cur, 0);
     }
    
-    value_type access() const { return *m_cur; }
-
-    void first() { // find the first element passing filter().
-      for (; m_cur != m_end; ++m_cur)
-        if (filter(*m_cur)) break;
+    constexpr value_type access() const { return *m_cur; }
+
+    constexpr void first() { // find the first element passing filter().
+      if constexpr (simd::can_compact<IterT, SentT, func>::value) {
+        if (m_cur != m_end) m_cur += simd::find(&*m_cur, m_end - m_cur, this->fn());
+      }
+      else {
+        for (; m_cur != m_end; ++m_cur)
+          if (this->fn()(*m_cur)) break;
+      }
     }
 
-    void advance() { // find the next element passing filter().
+    constexpr void advance() { // find the next element passing filter().
       if (m_cur == m_end) return; 
-      for (++m_cur; m_cur != m_end; ++m_cur)
-        if (filter(*m_cur)) break;
+      ++m_cur;
+      first();
     }
 
+    constexpr bool reached(const sentinel&) const {
+      return m_cur == m_end;
+    }
+
+    // Internal iteration: see _for_each in FIter.h. The current item is already known to
+    // pass, so it is sent on first and the predicate is only called on those after it.
+    static const IterT& end_of(const const_iterator&, const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const const_iterator& b, const sentinel&) { return b.m_end; }
+    static Unreachable end_of(const const_iterator&, Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(b, e), bool()) {
+      const auto& end = end_of(b, e);
+      if constexpr (simd::can_compact<IterT, SentT, func>::value) {
+        auto each = [&sink](value_type* items, std::size_t n) {
+          for(std::size_t i = 0; i < n; ++i)
+            if(!sink(items[i])) return false;
+          return true;
+        };
+        return push_compacted<default_batch_size>(b.m_cur, end, b.fn(), each);
+      }
+      if(b.m_cur == end) return true;
+      if(!sink(*b.m_cur)) return false;
+      IterT next = b.m_cur;
+      const func& f = b.fn();
+      return _for_each(++next, end, [&](auto&& x) { return !f(x) || sink(std::forward<decltype(x)>(x)); });
+    }
+
+    // The same, a block at a time: each block is compacted down to the passing items.
+    // Trivially copyable items are compacted without branching: every item is copied down,
+    // and only those which pass are kept. Those of 4 or 8 bytes are tested first, a block at
+    // once, and then moved with SIMD (see compact_flagged in Simd.h). The compaction of each
+    // block is traced (see Trace.h).
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(b, e), bool()) {
+      const auto& end = end_of(b, e);
+      if constexpr (simd::can_compact<IterT, SentT, func>::value)
+        return push_compacted<N>(b.m_cur, end, b.fn(), sink);
+      if(b.m_cur == end) return true;
+      value_type first = *b.m_cur;
+      if(!sink(&first, 1)) return false;
+      IterT next = b.m_cur;
+      const func& f = b.fn();
+      return _for_each_batch<N>(++next, end, [&](auto* items, std::size_t n) {
+        std::size_t kept = 0;
+        {
+          FITER_TRACE("Filter");
+          typedef typename std::decay<decltype(*items)>::type item_type;
+          if constexpr (simd::is_flagged_type<item_type>::value) {
+            std::uint32_t flags[N];
+            for_block(n, [&](std::size_t i) { flags[i] = f(items[i]) ? 1 : 0; });
+            kept = simd::compact_flagged(items, n, flags, items);
+          }
+          else if constexpr (std::is_trivially_copyable<value_type>::value) {
+            for(std::size_t i = 0; i < n; ++i) {
+              bool pass = f(items[i]);
+              items[kept] = items[i];
+              kept += pass;
+            }
+          }
+          else {
+            for(std::size_t i = 0; i < n; ++i)
+              if(f(items[i])) items[kept++] = std::move(items[i]);
+          }
+        }
+        return kept == 0 || sink(items, kept);
+      });
+    }
+
+    // Splitting by position: see _slice in FIter.h. Positions are those of the original
+    // iterators, and each piece finds its own first passing item. Only for iterators which
+    // end in iterators, since each piece needs an end of its own.
+    template <class It = const_iterator, class = typename std::enable_if<std::is_same<SentT, IterT>::value, It>::type>
+    static auto slice_length(const It& b, const It& e) -> decltype(_slice_length(b.m_cur, e.m_cur, 0)) {
+      return _slice_length(b.m_cur, e.m_cur, 0);
+    }
+
+    template <class It = const_iterator, class = typename std::enable_if<std::is_same<SentT, IterT>::value, It>::type>
+    static auto slice(const It& b, const It& e, std::ptrdiff_t lo, std::ptrdiff_t hi) -> decltype(_slice(b.m_cur, e.m_cur, lo, hi, 0), std::pair<It, It>(b, e)) {
+      auto inner = _slice(b.m_cur, e.m_cur, lo, hi, 0);
+      return std::make_pair(const_iterator(inner.first, inner.second, b.fn()), const_iterator(inner.second, inner.second, b.fn()));
+    }
+
+    // Where SIMD applies, the original array is compacted straight into blocks of passing
+    // items, which go to sink(items, n).
+    template <std::size_t N, class Sink>
+    static bool push_compacted(const IterT& from, const IterT& to, const func& f, Sink& sink) {
+      value_type passed[N];
+      if (from == to) return true;
+      const value_type* items = &*from;
+      std::ptrdiff_t length = to - from;
+      for(std::ptrdiff_t i = 0; i < length; i += N) { // an index: a pointer past the end is undefined
+        std::size_t kept;
+        {
+          FITER_TRACE("Filter");
+          kept = simd::compact(items + i, std::min<std::ptrdiff_t>(length - i, N), f, passed);
+        }
+        if(kept > 0 && !sink(passed, kept)) return false;
+      }
+      return true;
+    }
 
    
 
-    const_iterator(const IterT & _cur, const IterT & _end, std::function<bool(value_type)> _filter) : m_cur(_cur), m_end(_end), filter(_filter)
+    constexpr const_iterator(const IterT & _cur, const SentT & _end, const func & _filter) : Function_base<func>(_filter), m_cur(_cur), m_end(_end)
     { first(); } 
 
-    const_iterator(const const_iterator& r) :  m_cur(r.m_cur),  m_end(r.m_end), filter(r.filter)
-    { first(); }
+    // Copies are already positioned on a passing element (or the end), so there is no
+    // need to call first() again.
+    constexpr const_iterator(const const_iterator& r) : Function_base<func>(r), m_cur(r.m_cur),  m_end(r.m_end)
+    {}
     
-    const_iterator& operator=(const const_iterator& r)
-    { m_cur = r.m_cur; m_end = r.m_end; filter = r.filter; first(); return *this; }
+    constexpr const_iterator& operator=(const const_iterator& r)
+    { Function_base<func>::operator=(r); m_cur = r.m_cur; m_end = r.m_end; return *this; }
   };
   
 
-  FilteredObject(IterT _begin, IterT _end, std::function<bool(value_type)> _filter) : m_begin(_begin), m_end(_end), filter(_filter)
+  constexpr FilteredObject(IterT _begin, SentT _end, func _filter) : m_begin(_begin), m_end(_end), filter(_filter)
   {}
    
-  const_iterator begin() const {
+  constexpr const_iterator begin() const {
     return const_iterator(m_begin, m_end, filter);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end, m_end, filter);
+  constexpr auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, m_end, filter);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel();
   }
+
+  friend struct Fusion; // see Pipe.h
 };
 
 
@@ -105,18 +239,18 @@ class FilteredObject {
 
 // Stores a function. When called on a pair of iterators, returns a FilteredObject which
 // iterates between them using the passed function as a filter.
-// 'func' is 'std::function<bool, ValueT>', in this case.
+// 'func' is any type callable as 'bool(ValueT)', in this case.
 // Its purposes are to allow currying and implicit template instantiation.
 template <typename func>
 class FilterOn {
   public:
   func f;
   
-  FilterOn(func _f) : f(_f) {}
+  constexpr FilterOn(func _f) : f(_f) {}
   
-  template <typename IterT>
-  FilteredObject<IterT> operator() (IterT start, IterT end) {
-    return FilteredObject<IterT>(start, end, f);
+  template <typename IterT, typename SentT>
+  constexpr FilteredObject<IterT, func, SentT> operator() (IterT start, SentT end) {
+    return FilteredObject<IterT, func, SentT>(start, end, f);
   }
 };
 
@@ -128,16 +262,10 @@ class FilterOn {
 
 // Filter takes a boolean function and returns a FilterOn<> storing that function.
 // Only necessary to allow implicit template instantiation and lambdas.
-// Two versions: this for callable objects, the next for function pointers.
+// Callable objects are stored as they are; functions decay to function pointers.
 template<typename F>
-auto Filter(F f) -> FilterOn<std::function<bool(typename function_traits<decltype(&F::operator())>::arg_type)> >
-{
-  return FilterOn<std::function<bool(typename function_traits<decltype(&F::operator())>::arg_type)>>(f);
-}
-
-template<typename A>
-FilterOn<std::function<bool(A)>> Filter(bool(&f)(A)) {
-  return FilterOn<std::function<bool(A)>>(f);
+constexpr FilterOn<F> Filter(F f) {
+  return FilterOn<F>(f);
 }
 
 
@@ -0,0 +1,69 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <utility>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A 'fold' terminal.
+//
+// The point of this file. Given a pair of iterators, or an object with begin() and end()
+// (such as any of the objects in this library), combines the items into a single value:
+// starting from init, each item is folded in as 'acc = f(acc, item)', left to right.
+//
+// As with ForEach, items are pushed through every stage in one loop (see _for_each in
+// FIter.h), so a sum over a Map/Filter/Take pipeline compiles much as a hand-written one
+// would.
+//
+// Create using Fold(), below.
+//
+
+// Usage example:
+//
+// std::vector<int> v{0, 1, 2, 3, 4, 5, 6};
+// auto vm = FIter::Map([](int x){ return x * x; })(v.begin(), v.end());
+// std::cout << FIter::Fold(0, [](int a, int x){ return a + x; })(vm);
+//
+// This will print '91'.
+
+
+// Stores an initial value and a function. When called on a pair of iterators or an
+// object, returns the fold of its items.
+// Its purposes are to allow currying and implicit template instantiation.
+template <typename ValueT, typename func>
+struct FoldOn {
+  ValueT init;
+  func f;
+
+  FoldOn(ValueT _init, func _f) : init(_init), f(_f) {}
+
+  template <typename IterT, typename SentT>
+  ValueT operator() (IterT start, SentT end) const {
+    FITER_TRACE("Fold");
+    ValueT acc = init;
+    _for_each(start, end, [&](auto&& x) { acc = f(std::move(acc), std::forward<decltype(x)>(x)); return true; });
+    return acc;
+  }
+
+  template <typename Range>
+  ValueT operator() (const Range& r) const {
+    return (*this)(r.begin(), r.end());
+  }
+};
+
+
+
+// Fold takes an initial value and a function and returns a FoldOn<> storing them.
+// Callable objects are stored as they are; functions decay to function pointers.
+template<typename ValueT, typename F>
+FoldOn<ValueT, F> Fold(ValueT init, F f) {
+  return FoldOn<ValueT, F>(init, f);
+}
+
+
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef FOREACH_H
+#define FOREACH_H
+
+#include <utility>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A 'for-each' terminal.
+//
+// The point of this file. Given a pair of iterators, or an object with begin() and end()
+// (such as any of the objects in this library), calls a function on each item in turn.
+//
+// Unlike a range-for loop, this doesn't step the outermost iterators along one at a time:
+// items are pushed from the innermost iterators through every stage in one loop (see
+// _for_each in FIter.h). Over a vector, a Map/Filter/Take pipeline compiles to much the
+// same loop one would write by hand, which the compiler can then vectorise.
+//
+// Create using ForEach(), below.
+//
+
+// Usage example:
+//
+// std::vector<int> v{0, 1, 2, 3, 4, 5, 6};
+// auto vf = FIter::Filter(is_odd)(v.begin(), v.end());
+// FIter::ForEach([](int x){ std::cout << x << ','; })(vf);
+//
+// This will print '1,3,5,'.
+
+
+// Stores a function. When called on a pair of iterators or an object, calls that function
+// on each item, and returns it.
+// Its purposes are to allow currying and implicit template instantiation.
+template <typename func>
+struct ForEachOn {
+  func f;
+
+  ForEachOn(func _f) : f(_f) {}
+
+  template <typename IterT, typename SentT>
+  func operator() (IterT start, SentT end) {
+    FITER_TRACE("ForEach");
+    _for_each(start, end, [this](auto&& x) { f(std::forward<decltype(x)>(x)); return true; });
+    return f;
+  }
+
+  template <typename Range>
+  func operator() (const Range& r) {
+    return (*this)(r.begin(), r.end());
+  }
+};
+
+
+
+// ForEach takes a function and returns a ForEachOn<> storing that function.
+// Callable objects are stored as they are; functions decay to function pointers.
+template<typename F>
+ForEachOn<F> ForEach(F f) {
+  return ForEachOn<F>(f);
+}
+
+
+
+
+// The same, a block at a time: the function is called as f(items, n) with up to N items
+// at once (see _for_each_batch in FIter.h), and may modify them. Stages then work on whole
+// blocks rather than single items, which lets the compiler vectorise each stage's loop
+// separately even where the pipeline as a whole has too many branches. (Loops over a block
+// written with for_block, in FIter.h, are vectorised at -O2 as well.)
+//
+// Usage example:
+//
+// auto vm = FIter::Map(square)(v.begin(), v.end());
+// long total = 0;
+// FIter::ForEachBatch<64>([&](int* items, std::size_t n){
+//   for(std::size_t i = 0; i < n; ++i) total += items[i];
+// })(vm);
+template <std::size_t N, typename func>
+struct ForEachBatchOn {
+  func f;
+
+  ForEachBatchOn(func _f) : f(_f) {}
+
+  template <typename IterT, typename SentT>
+  func operator() (IterT start, SentT end) {
+    FITER_TRACE("ForEachBatch");
+    _for_each_batch<N>(start, end, [this](auto* items, std::size_t n) { f(items, n); return true; });
+    return f;
+  }
+
+  template <typename Range>
+  func operator() (const Range& r) {
+    return (*this)(r.begin(), r.end());
+  }
+};
+
+
+
+// ForEachBatch takes a block size and a function and returns a ForEachBatchOn<> storing
+// that function.
+template<std::size_t N = default_batch_size, typename F>
+ForEachBatchOn<N, F> ForEachBatch(F f) {
+  return ForEachBatchOn<N, F>(f);
+}
+
+
+
+}
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A streaming reader of lines, or of records ending in any other delimiter.
+//
+// The point of this file. Given a file's path, or an open file descriptor (a pipe, a
+// socket, standard input), it can create input iterators (a nested subtype) over the
+// records in it, each a std::string_view into the reader's buffer, without the delimiter.
+// Nothing is allocated per record: the file is read into a page-aligned buffer a block at
+// a time, as the iterators reach the end of what has been read, and delimiters are found
+// with memchr (which is vectorized in any C library worth using).
+//
+// So a record's string_view is only valid until the iterator moves on: copy it into a
+// std::string to keep it. And, as for any input iterator, there is only one pass: all
+// iterators share the reader's place, and begin() is wherever that is.
+//
+// Since nothing is read until it is needed, a TakeWhile over a reader stops reading as
+// soon as its predicate fails, a block or less past the failing record. Stages which work
+// a block of records at a time (see _for_each_batch in FIter.h) are only given records
+// already read, all valid together, and each block is passed on before any more is read.
+//
+// The last record needn't end in a delimiter. Records longer than a block make the buffer
+// grow to fit them. Errors opening or reading are thrown, as std::system_error.
+//
+// end() is an empty sentinel. LineReader can't be copied or moved, since iterators point
+// at it.
+//
+
+// Usage example:
+//
+// FIter::LineReader log("server.log");
+// auto errors = FIter::Filter([](std::string_view l){ return l.find("ERROR") != l.npos; })(log.begin(), log.end());
+// for(auto line : errors)
+//   std::cout << line << '\n';
+//
+// This will print the lines of server.log containing 'ERROR'.
+
+class LineReader {
+ public:
+  typedef void owns_items; // Its iterators point into it: see FIter.h.
+
+  // Reads are in blocks of this many bytes by default: enough to make the cost of each
+  // read() small, and few enough to stay in cache.
+  static const std::size_t default_block = 1 << 16;
+
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<std::input_iterator_tag, std::string_view>,
+  public Iterator_base<std::input_iterator_tag, const_iterator, std::string_view>
+  {
+    const LineReader* m_cur;
+
+    std::string_view access() const { return m_cur->m_record; }
+    const std::string_view* operator->() const { return &m_cur->m_record; }
+
+    void advance() { m_cur->next(); }
+
+    bool reached(const sentinel&) const { return m_cur->m_done; }
+
+    // Internal iteration a block at a time: see _for_each_batch in FIter.h. Reading more
+    // moves the buffer, so copies of earlier records would go stale: a block ends where
+    // the read data does, and is used before the next read.
+    template <std::size_t N, class Sink>
+    static bool push_batch(const const_iterator& b, const sentinel&, Sink& sink) {
+      return b.m_cur->push_batch<N>(sink);
+    }
+
+    explicit const_iterator(const LineReader* _cur) : m_cur(_cur)
+    {}
+  };
+
+
+  explicit LineReader(const std::string& path, char delim = '\n', std::size_t block = default_block) :
+    LineReader(open(path), true, delim, block)
+  {}
+
+  // Reads from an open file descriptor, which is closed afterwards only if 'own' is true.
+  LineReader(int fd, bool own, char delim = '\n', std::size_t block = default_block) :
+    m_fd(fd), m_own(own), m_delim(delim), m_started(false), m_done(false), m_eof(false), m_bytes_read(0)
+  {
+    m_capacity = (block + page - 1) / page * page;
+    if(m_capacity == 0) m_capacity = page;
+    m_buffer = static_cast<char*>(::operator new[](m_capacity, std::align_val_t(page)));
+    m_from = m_to = m_buffer;
+  }
+
+  ~LineReader() {
+    ::operator delete[](m_buffer, std::align_val_t(page));
+    if(m_own) ::close(m_fd);
+  }
+
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+
+  // Reads the first record, if this is the first call. (const, like other objects'
+  // begin(), so that readers can be passed to Fold, Collect and the rest; the buffer and
+  // the place in the file are the only state, and are mutable.)
+  const_iterator begin() const {
+    if(!m_started) {
+      m_started = true;
+      next();
+    }
+    return const_iterator(this);
+  }
+
+  sentinel end() const {
+    return sentinel();
+  }
+
+  // How much of the file has been read so far.
+  std::size_t bytes_read() const {
+    return m_bytes_read;
+  }
+
+
+ private:
+  static const std::size_t page = 4096;
+
+  int m_fd;
+  bool m_own;
+  char m_delim;
+
+  mutable char* m_buffer;
+  mutable std::size_t m_capacity;
+  mutable char* m_from; // the unused part of what has been read is [m_from, m_to)
+  mutable char* m_to;
+
+  mutable std::string_view m_record;
+  mutable bool m_started;
+  mutable bool m_done; // true once the records have run out
+  mutable bool m_eof;
+  mutable std::size_t m_bytes_read;
+
+  static int open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+      throw std::system_error(errno, std::generic_category(), path);
+    return fd;
+  }
+
+  // Sends the records from the current one on to sink(records, n), in blocks of those
+  // already read. The reader is left on the last record sent.
+  template <std::size_t N, class Sink>
+  bool push_batch(Sink& sink) const {
+    std::string_view records[N];
+    while(!m_done) {
+      std::size_t n = 0;
+      records[n++] = m_record;
+      while(n < N && next_read())
+        records[n++] = m_record;
+      if(!sink(records, n)) return false;
+      next();
+    }
+    return true;
+  }
+
+  // Finds the next record if it has been read in full, reading nothing. Returns false
+  // otherwise, leaving the current record as it is.
+  bool next_read() const {
+    const char* d = static_cast<const char*>(std::memchr(m_from, m_delim, m_to - m_from));
+    if(!d) return false;
+    m_record = std::string_view(m_from, d - m_from);
+    m_from = const_cast<char*>(d) + 1;
+    return true;
+  }
+
+  // Finds the next record, reading more as needed.
+  void next() const {
+    const char* scanned = m_from; // no delimiter in [m_from, scanned)
+    while(true) {
+      if(const char* d = static_cast<const char*>(std::memchr(scanned, m_delim, m_to - scanned))) {
+        m_record = std::string_view(m_from, d - m_from);
+        m_from = const_cast<char*>(d) + 1;
+        return;
+      }
+      if(m_eof) { // the last record, if the file doesn't end in a delimiter
+        m_done = (m_from == m_to);
+        m_record = std::string_view(m_from, m_to - m_from);
+        m_from = m_to;
+        return;
+      }
+      std::size_t kept = m_to - m_from;
+      refill();
+      scanned = m_from + kept;
+    }
+  }
+
+  // Moves the unused part of the buffer to its start, growing it if that fills it, and
+  // reads as much as fits after it.
+  void refill() const {
+    std::size_t kept = m_to - m_from;
+    if(kept == m_capacity) {
+      std::size_t grown = m_capacity * 2;
+      char* buffer = static_cast<char*>(::operator new[](grown, std::align_val_t(page)));
+      std::memcpy(buffer, m_from, kept);
+      ::operator delete[](m_buffer, std::align_val_t(page));
+      m_buffer = buffer;
+      m_capacity = grown;
+    }
+    else if(m_from != m_buffer)
+      std::memmove(m_buffer, m_from, kept);
+    m_from = m_buffer;
+    m_to = m_buffer + kept;
+
+    ssize_t n;
+    do n = ::read(m_fd, m_to, m_capacity - kept);
+    while(n < 0 && errno == EINTR);
+    if(n < 0)
+      throw std::system_error(errno, std::generic_category(), "read");
+    if(n == 0) m_eof = true;
+    m_to += n;
+    m_bytes_read += n;
+  }
+};
+
+
+
+}
+
+#endif
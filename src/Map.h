@@ -1,9 +1,12 @@
 #ifndef MAP_H
 #define MAP_H
 
-#include <functional>
+#include <algorithm>
 #include <iterator>
+#include <type_traits>
+#include <utility>
 #include "FIter.h"
+#include "Simd.h"
 
 namespace FIter {
 
@@ -16,7 +19,7 @@ struct Map_unadvance {};
 
 template <class IterT> // only define unadvance if bidiretional
 struct Map_unadvance<std::bidirectional_iterator_tag, IterT> {
-    void unadvance() {
+    constexpr void unadvance() {
       auto parent = static_cast<IterT*>(this);
     	--(parent->m_cur);
     }
@@ -25,11 +28,21 @@ struct Map_unadvance<std::bidirectional_iterator_tag, IterT> {
 
 // A mapping iterator.
 //
-// The point of this file. Given a pair of iterators of type IterT and a function,
-// it can create iterators (a nested subtype) exporting all constant functions of the
+// The point of this file. Given a pair of iterators of type IterT and a function of type
+// func, it can create iterators (a nested subtype) exporting all constant functions of the
 // original iterators. However, these iterators, when dereferenced, return the result of
 // said function applied to the original value.
 //
+// The end of the pair may be a sentinel of type SentT instead. end() is a const_iterator
+// when SentT is IterT, an Unreachable when SentT is, and otherwise a sentinel wrapping the
+// original one.
+//
+// If the original pair is sized (see FIter.h), so is this one, and size() is defined.
+//
+// The function is called through a const reference, so it must have a const operator():
+// a lambda marked 'mutable' is rejected at compile time. Keep any state it needs outside
+// it, by reference.
+//
 // Create using Map(), below.
 //
 
@@ -43,29 +56,35 @@ struct Map_unadvance<std::bidirectional_iterator_tag, IterT> {
 // This will print '0,1,0,1,0,1,0,', assuming 'mod2' is defined appropriately. (Say, as
 // 'int mod2(int x){return x%2;}'.
 
-template<typename IterT, typename value_type>
+template<typename IterT, typename func, typename SentT = IterT>
 class MapObject {
+  static_assert(std::is_invocable<const func&, decltype(*std::declval<const IterT&>())>::value,
+                "Map's function must be callable as const: a mutable lambda isn't");
 
-  // Note: input_type is the type stored by the parent iterator
-  // whereas value_type is the type stored by _this_ iterator, ie, the result of mapf
+  // Note: value_type is the type stored by _this_ iterator, ie, the result of mapf, as
+  // opposed to the type stored by the parent iterator.
 
-  typedef typename IterT::value_type input_type;
-  typedef typename IterT::iterator_category iterator_category;
+  typedef typename std::decay<decltype(std::declval<const func&>()(*std::declval<IterT>()))>::type value_type;
+  typedef typename std::iterator_traits<IterT>::iterator_category iterator_category;
 
  protected:
   const IterT m_begin;
-  const IterT m_end;
+  const SentT m_end;
  
-  std::function<value_type(input_type)> mapf;
+  func mapf;
 
 
  public:
-  struct const_iterator : public std::iterator<iterator_category, value_type>,
+  struct sentinel {
+    SentT m_end;
+  };
+
+  struct const_iterator : public Iterator_types<iterator_category, value_type>,
   public Iterator_base<iterator_category, const_iterator, value_type>,
-  public Map_unadvance<typename least_iterator_type<iterator_category, std::bidirectional_iterator_tag>::type, const_iterator>
+  public Map_unadvance<typename least_iterator_type<iterator_category, std::bidirectional_iterator_tag>::type, const_iterator>,
+  public Function_base<func>
   {
     IterT m_cur;
-    std::function<value_type(input_type)> mapf;
 
     // Get the iterator at the base of a chain of FIters. For example, if you apply a
     // filter to a vector, and then a map to the filter, calling this will return the
@@ -75,38 +94,141 @@ class MapObject {
       return _get_base<IterT>(m_cur, 0);
     }
    
-    value_type access() const { // The only thing Maps actually do.
-      return mapf(*m_cur);
+    constexpr value_type access() const { // The only thing Maps actually do.
+      return this->fn()(*m_cur);
     }
 
-    void advance() { // Nothing special for map.
+    constexpr void advance() { // Nothing special for map.
       ++m_cur;
     }
 
+    constexpr void advance(std::ptrdiff_t n) {
+      m_cur += n;
+    }
+
+    constexpr std::ptrdiff_t distance_from(const const_iterator& r) const {
+      return m_cur - r.m_cur;
+    }
+
+    constexpr bool reached(const sentinel& s) const {
+      return m_cur == s.m_end;
+    }
+
+    template <class S = SentT>
+    constexpr auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t(std::declval<const S&>() - m_cur)) {
+      return s.m_end - m_cur;
+    }
+
+    // Internal iteration: see _for_each in FIter.h. Items are pushed straight from the
+    // original iterators through mapf.
+    static const IterT& end_of(const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const sentinel& e) { return e.m_end; }
+    static Unreachable end_of(Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      const func& f = b.fn();
+      return _for_each(b.m_cur, end_of(e), [&](auto&& x) { return sink(f(std::forward<decltype(x)>(x))); });
+    }
+
+    // The same, a block at a time: transformed in place when mapf keeps the type, and into
+    // a block of our own otherwise, or when the original items are in an array, which is
+    // then read straight from rather than copied into a block first. Items which can't be
+    // default constructed are passed on one at a time. The transformation of each block is
+    // traced (see Trace.h).
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      const func& f = b.fn();
+      typedef typename std::decay<decltype(end_of(e))>::type end_type;
+      if constexpr (is_contiguous<IterT>::value && std::is_same<end_type, IterT>::value && std::is_default_constructible<value_type>::value) {
+        value_type mapped[N];
+        const IterT& end = end_of(e);
+        for(IterT from = b.m_cur; from != end; ) {
+          std::size_t n = std::min<std::ptrdiff_t>(end - from, N);
+          {
+            FITER_TRACE("Map");
+            for_block(n, [&](std::size_t i) { mapped[i] = f(from[i]); });
+          }
+          from += n;
+          if(!sink(mapped, n)) return false;
+        }
+        return true;
+      }
+      else return _for_each_batch<N>(b.m_cur, end_of(e), [&](auto* items, std::size_t n) {
+        if constexpr (std::is_same<typename std::decay<decltype(*items)>::type, value_type>::value) {
+          {
+            FITER_TRACE("Map");
+            for_block(n, [&](std::size_t i) { items[i] = f(items[i]); });
+          }
+          return sink(items, n);
+        }
+        else if constexpr (!std::is_default_constructible<value_type>::value) {
+          for(std::size_t i = 0; i < n; ++i) {
+            value_type y = f(items[i]);
+            if(!sink(&y, 1)) return false;
+          }
+          return true;
+        }
+        else {
+          value_type mapped[N];
+          {
+            FITER_TRACE("Map");
+            for_block(n, [&](std::size_t i) { mapped[i] = f(items[i]); });
+          }
+          return sink(mapped, n);
+        }
+      });
+    }
+
+    // Splitting by position: see _slice in FIter.h. Positions are those of the original
+    // iterators.
+    template <class It = const_iterator>
+    static auto slice_length(const It& b, const It& e) -> decltype(_slice_length(b.m_cur, e.m_cur, 0)) {
+      return _slice_length(b.m_cur, e.m_cur, 0);
+    }
+
+    template <class It = const_iterator>
+    static auto slice(const It& b, const It& e, std::ptrdiff_t lo, std::ptrdiff_t hi) -> decltype(_slice(b.m_cur, e.m_cur, lo, hi, 0), std::pair<It, It>(b, e)) {
+      auto inner = _slice(b.m_cur, e.m_cur, lo, hi, 0);
+      return std::make_pair(const_iterator(inner.first, b.fn()), const_iterator(inner.second, b.fn()));
+    }
+
 
    
 
-    const_iterator(const IterT & _cur, std::function<value_type(input_type)> _mapf) : m_cur(_cur), mapf(_mapf)
+    constexpr const_iterator(const IterT & _cur, const func & _mapf) : Function_base<func>(_mapf), m_cur(_cur)
     {} 
 
-    const_iterator(const const_iterator& r) : m_cur(r.m_cur), mapf(r.mapf)
+    constexpr const_iterator(const const_iterator& r) : Function_base<func>(r), m_cur(r.m_cur)
     {}
     
-    const_iterator& operator=(const const_iterator& r)
-    { m_cur = r.m_cur; mapf = r.mapf; return *this; }
+    constexpr const_iterator& operator=(const const_iterator& r)
+    { Function_base<func>::operator=(r); m_cur = r.m_cur; return *this; }
   };
   
 
-  MapObject(IterT _begin, IterT _end, std::function<value_type(input_type)> _mapf) : m_begin(_begin), m_end(_end), mapf(_mapf)
+  constexpr MapObject(IterT _begin, SentT _end, func _mapf) : m_begin(_begin), m_end(_end), mapf(_mapf)
   {}
    
-  const_iterator begin() const {
+  constexpr const_iterator begin() const {
     return const_iterator(m_begin, mapf);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end, mapf);
+  constexpr auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, mapf);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel{m_end};
+  }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value>::type>
+  constexpr std::ptrdiff_t size() const { // See FIter.h for _length.
+    return _length(m_begin, m_end);
   }
+
+  friend struct Fusion; // see Pipe.h
 };
 
 
@@ -120,14 +242,13 @@ class MapObject {
 // Its purposes are to allow currying and implicit template instantiation.
 template <typename func>
 struct MapOn {
-  typedef typename function_traits<decltype(&func::operator())>::result_type value_type;
   func f;
   
-  MapOn(func _f) : f(_f) {}
+  constexpr MapOn(func _f) : f(_f) {}
   
-  template <typename IterT>
-  MapObject<IterT, value_type> operator() (IterT start, IterT end) {
-    return MapObject<IterT, value_type>(start, end, f);
+  template <typename IterT, typename SentT>
+  constexpr MapObject<IterT, func, SentT> operator() (IterT start, SentT end) {
+    return MapObject<IterT, func, SentT>(start, end, f);
   }
 };
 
@@ -139,16 +260,10 @@ struct MapOn {
 
 // Map takes a function and returns a MapOn<> storing that function.
 // Only necessary to allow implicit template instantiation and lambdas.
-// Two versions: this for callable objects, the next for function pointers.
+// Callable objects are stored as they are; functions decay to function pointers.
 template<typename F>
-auto Map(F f) -> MapOn<std::function<typename function_traits<decltype(&F::operator())>::result_type (typename function_traits<decltype(&F::operator())>::arg_type)> >
-{
-  return MapOn<std::function<typename function_traits<decltype(&F::operator())>::result_type(typename function_traits<decltype(&F::operator())>::arg_type)>>(f);
-}
-
-template<typename R, typename A>
-MapOn<std::function<R(A)>> Map(R(&f)(A)) {
-  return Map<std::function<R(A)>>(f);
+constexpr MapOn<F> Map(F f) {
+  return MapOn<F>(f);
 }
 
 
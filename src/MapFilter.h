@@ -0,0 +1,234 @@
+#ifndef MAPFILTER_H
+#define MAPFILTER_H
+
+#include <iterator>
+#include <optional>
+#include <utility>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A mapping and filtering iterator.
+//
+// The point of this file. Given a pair of iterators of type IterT, a function of type
+// mapf and a boolean function of type filterf, it can create forward iterators (a nested
+// subtype) over the results of mapf applied to the original items, skipping those for
+// which filterf returns false: the same items as a Filter over a Map, but in one stage.
+// Each iterator keeps the mapped value of the item it is on, so mapf is called exactly
+// once per original item, where a Filter over a Map calls it again whenever a passing
+// item is dereferenced.
+//
+// The end of the pair may be a sentinel of type SentT instead. end() is a const_iterator
+// when SentT is IterT, an Unreachable when SentT is, and otherwise an empty sentinel.
+//
+// Create using MapFilter(), below, or by piping a Map into a Filter (see Pipe.h).
+//
+
+// Usage example:
+//
+// std::vector<int> v{0, 1, 2, 3, 4, 5, 6};
+// auto vmf = FIter::MapFilter(square, mod2)(v.begin(), v.end());
+// for(auto x : vmf)
+//   std::cout << x << ",";
+//
+// This will print '0,4,16,36,', assuming 'square' and 'mod2' are defined appropriately.
+// (Say, as 'int square(int x){return x*x;}' and 'bool mod2(int x){return x%2==0;}'.)
+
+// The two functions, stored together so that iterators need only one Function_base.
+template <typename mapf, typename filterf>
+struct Map_filter_fns {
+  mapf map;
+  filterf test;
+};
+
+template<typename IterT, typename mapf, typename filterf, typename SentT = IterT>
+class MapFilterObject {
+
+  typedef typename std::decay<decltype(std::declval<const mapf&>()(*std::declval<IterT>()))>::type value_type;
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT>::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+  typedef Map_filter_fns<mapf, filterf> fns;
+
+ protected:
+  const IterT m_begin;
+  const SentT m_end;
+
+  fns m_fns;
+
+
+ public:
+  // Iterators know their own end, so the sentinel needs nothing.
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
+  public Iterator_base<least_common_subtype, const_iterator, value_type>,
+  public Function_base<fns>
+  {
+    IterT m_cur;
+    SentT m_end;
+    std::optional<value_type> m_item; // mapf of *m_cur, unless at the end
+
+    auto get_base() -> decltype(_get_base<IterT>(m_cur, 0)) {
+      return _get_base<IterT>(m_cur, 0);
+    }
+
+    const value_type& access() const { return *m_item; }
+    const value_type* operator->() const { return &*m_item; }
+
+    void first() { // find the first item whose mapped value passes.
+      for (; m_cur != m_end; ++m_cur) {
+        m_item.emplace(this->fn().map(*m_cur));
+        if (this->fn().test(*m_item)) return;
+      }
+      m_item.reset();
+    }
+
+    void advance() {
+      if (m_cur == m_end) return;
+      ++m_cur;
+      first();
+    }
+
+    bool reached(const sentinel&) const {
+      return m_cur == m_end;
+    }
+
+    // Internal iteration: see _for_each in FIter.h. The current item is already mapped and
+    // known to pass, so it is sent on first.
+    static const IterT& end_of(const const_iterator&, const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const const_iterator& b, const sentinel&) { return b.m_end; }
+    static Unreachable end_of(const const_iterator&, Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(b, e), bool()) {
+      const auto& end = end_of(b, e);
+      if(b.m_cur == end) return true;
+      if(!sink(*b.m_item)) return false;
+      IterT next = b.m_cur;
+      const fns& f = b.fn();
+      return _for_each(++next, end, [&](auto&& x) {
+        value_type y = f.map(std::forward<decltype(x)>(x));
+        return !f.test(y) || sink(std::move(y));
+      });
+    }
+
+    // The same, a block at a time: each block is mapped into one of our own, compacted down
+    // to the passing items as it goes; or, for items which can't be default constructed,
+    // each passing item is passed on alone.
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(b, e), bool()) {
+      const auto& end = end_of(b, e);
+      if(b.m_cur == end) return true;
+      value_type first = *b.m_item;
+      if(!sink(&first, 1)) return false;
+      IterT next = b.m_cur;
+      const fns& f = b.fn();
+      return _for_each_batch<N>(++next, end, [&](auto* items, std::size_t n) {
+        if constexpr (!std::is_default_constructible<value_type>::value) {
+          for(std::size_t i = 0; i < n; ++i) {
+            value_type y = f.map(items[i]);
+            if(f.test(y) && !sink(&y, 1)) return false;
+          }
+          return true;
+        }
+        else {
+          value_type mapped[N];
+          std::size_t kept = 0;
+          for(std::size_t i = 0; i < n; ++i) {
+            mapped[kept] = f.map(items[i]);
+            kept += f.test(mapped[kept]) ? 1 : 0;
+          }
+          return kept == 0 || sink(mapped, kept);
+        }
+      });
+    }
+
+    // Splitting by position: see _slice in FIter.h. As for Filter, positions are those of
+    // the original iterators, and only for iterators which end in iterators.
+    template <class It = const_iterator, class = typename std::enable_if<std::is_same<SentT, IterT>::value, It>::type>
+    static auto slice_length(const It& b, const It& e) -> decltype(_slice_length(b.m_cur, e.m_cur, 0)) {
+      return _slice_length(b.m_cur, e.m_cur, 0);
+    }
+
+    template <class It = const_iterator, class = typename std::enable_if<std::is_same<SentT, IterT>::value, It>::type>
+    static auto slice(const It& b, const It& e, std::ptrdiff_t lo, std::ptrdiff_t hi) -> decltype(_slice(b.m_cur, e.m_cur, lo, hi, 0), std::pair<It, It>(b, e)) {
+      auto inner = _slice(b.m_cur, e.m_cur, lo, hi, 0);
+      return std::make_pair(const_iterator(inner.first, inner.second, b.fn()), const_iterator(inner.second, inner.second, b.fn()));
+    }
+
+
+
+    const_iterator(const IterT & _cur, const SentT & _end, const fns & _fns) : Function_base<fns>(_fns), m_cur(_cur), m_end(_end)
+    { first(); }
+
+    // Copies are already positioned on a passing item (or the end), with its mapped value.
+    const_iterator(const const_iterator& r) : Function_base<fns>(r), m_cur(r.m_cur), m_end(r.m_end), m_item(r.m_item)
+    {}
+
+    const_iterator& operator=(const const_iterator& r)
+    { Function_base<fns>::operator=(r); m_cur = r.m_cur; m_end = r.m_end; m_item = r.m_item; return *this; }
+  };
+
+
+  MapFilterObject(IterT _begin, SentT _end, mapf _map, filterf _test) : m_begin(_begin), m_end(_end), m_fns{_map, _test}
+  {}
+
+  const_iterator begin() const {
+    return const_iterator(m_begin, m_end, m_fns);
+  }
+
+  auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, m_end, m_fns);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel();
+  }
+
+  friend struct Fusion; // see Pipe.h
+};
+
+
+
+
+
+
+
+// Stores a mapping function and a boolean function. When called on a pair of iterators,
+// returns a MapFilterObject which maps the items between them, keeping those which pass.
+// Its purposes are to allow currying and implicit template instantiation.
+template <typename mapf, typename filterf>
+struct MapFilterOn {
+  mapf map;
+  filterf test;
+
+  MapFilterOn(mapf _map, filterf _test) : map(_map), test(_test) {}
+
+  template <typename IterT, typename SentT>
+  MapFilterObject<IterT, mapf, filterf, SentT> operator() (IterT start, SentT end) {
+    return MapFilterObject<IterT, mapf, filterf, SentT>(start, end, map, test);
+  }
+};
+
+
+
+
+
+
+
+// MapFilter takes a mapping function and a boolean function, and returns a MapFilterOn<>
+// storing them. Callable objects are stored as they are; functions decay to function
+// pointers.
+template<typename M, typename F>
+MapFilterOn<M, F> MapFilter(M map, F test) {
+  return MapFilterOn<M, F>(map, test);
+}
+
+
+
+
+
+}
+
+#endif
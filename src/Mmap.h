@@ -0,0 +1,163 @@
+#ifndef MMAP_H
+#define MMAP_H
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A memory-mapped file of fixed-size records.
+//
+// The point of this file. Given the path of a binary file made of records of type T (which
+// must be trivially copyable, as anything written straight to a file is), it maps the
+// file into memory read-only and can create random access iterators (a nested subtype)
+// over its records, which can be passed to Map, Filter, Take, Drop, Zip and the rest like
+// a vector's. Nothing is read up front and nothing is copied: records are read from the
+// page cache as the pipeline reaches them, and the kernel is told to read ahead (see
+// Advice, below).
+//
+// Bytes left over at the end of the file, short of a whole record, are ignored. An empty
+// file gives an empty range. Errors opening or mapping the file are thrown, as
+// std::system_error with the path as its message.
+//
+// MmapRange can be moved but not copied; the mapping lasts until it is destroyed, and
+// its iterators are valid until then.
+//
+// Filters over int, float or double records with comparison predicates compact with SIMD
+// instructions, as over vectors (see Simd.h).
+//
+
+// Usage example:
+//
+// struct Trade { std::int64_t id; double price; };
+// FIter::MmapRange<Trade> trades("trades.bin");
+// auto prices = FIter::Map([](const Trade& t){ return t.price; })(trades.begin(), trades.end());
+// std::cout << FIter::Fold(0.0, [](double a, double p){ return a + p; })(prices);
+//
+// This will print the sum of the prices in the file.
+
+// How the file will be read: from start to end (the kernel reads ahead aggressively and
+// drops pages behind) or jumping about (no read-ahead). Either way, the kernel is asked
+// to start reading the file straight away.
+enum class Advice { sequential, random };
+
+template <typename T>
+class MmapRange {
+  static_assert(std::is_trivially_copyable<T>::value, "MmapRange needs records which can be read straight from a file");
+
+  typedef T value_type;
+
+ protected:
+  void* m_map;
+  std::size_t m_bytes;
+  std::size_t m_count;
+
+
+ public:
+  typedef void owns_items; // Its iterators point into its mapping: see FIter.h.
+
+  struct const_iterator : public Iterator_types<std::random_access_iterator_tag, value_type>,
+  public Iterator_base<std::random_access_iterator_tag, const_iterator, value_type>
+  {
+    typedef void contiguous; // See Simd.h.
+    typedef const T& reference;
+    typedef const T* pointer;
+
+    const T* m_cur;
+
+    const T& access() const { return *m_cur; }
+
+    const T& operator*() const { return *m_cur; }
+    const T* operator->() const { return m_cur; }
+    const T& operator[](std::ptrdiff_t n) const { return m_cur[n]; }
+
+    void advance() { ++m_cur; }
+    void unadvance() { --m_cur; }
+    void advance(std::ptrdiff_t n) { m_cur += n; }
+    std::ptrdiff_t distance_from(const const_iterator& r) const { return m_cur - r.m_cur; }
+
+    const_iterator() : m_cur(nullptr)
+    {}
+
+    explicit const_iterator(const T* _cur) : m_cur(_cur)
+    {}
+  };
+
+
+  explicit MmapRange(const std::string& path, Advice advice = Advice::sequential) : m_map(nullptr), m_bytes(0), m_count(0)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+      throw std::system_error(errno, std::generic_category(), path);
+    struct stat st;
+    if(::fstat(fd, &st) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), path);
+    }
+    m_bytes = (std::size_t)st.st_size;
+    m_count = m_bytes / sizeof(T);
+    if(m_count > 0) { // mmap can't map nothing
+      m_map = ::mmap(nullptr, m_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(m_map == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        m_map = nullptr;
+        throw std::system_error(err, std::generic_category(), path);
+      }
+      // Only hints: failing to take them changes nothing else.
+      ::madvise(m_map, m_bytes, advice == Advice::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+      ::madvise(m_map, m_bytes, MADV_WILLNEED);
+    }
+    ::close(fd); // the mapping keeps the file open
+  }
+
+  ~MmapRange() {
+    if(m_map) ::munmap(m_map, m_bytes);
+  }
+
+  MmapRange(const MmapRange&) = delete;
+  MmapRange& operator=(const MmapRange&) = delete;
+
+  MmapRange(MmapRange&& r) : m_map(r.m_map), m_bytes(r.m_bytes), m_count(r.m_count)
+  { r.m_map = nullptr; r.m_bytes = 0; r.m_count = 0; }
+
+  MmapRange& operator=(MmapRange&& r) {
+    std::swap(m_map, r.m_map);
+    std::swap(m_bytes, r.m_bytes);
+    std::swap(m_count, r.m_count);
+    return *this;
+  }
+
+  const T* data() const {
+    return static_cast<const T*>(m_map);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(data());
+  }
+
+  const_iterator end() const {
+    return const_iterator(data() + m_count);
+  }
+
+  std::ptrdiff_t size() const {
+    return m_count;
+  }
+};
+
+
+
+}
+
+#endif
@@ -0,0 +1,209 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+#include "Collect.h"
+#include "FIter.h"
+#include "Fold.h"
+#include "ThreadPool.h"
+
+namespace FIter {
+
+
+// A parallel 'fold' terminal.
+//
+// The point of this file. Like Fold, but the items are split between the threads of a
+// ThreadPool (by default ThreadPool::shared(), as many threads as the hardware has). The
+// range is halved recursively, down to pieces of at least 'grain' items; each piece is
+// folded with op starting from init, as by Fold, and the pieces' results are put together
+// with combine, in order: combine(left, right).
+//
+// So init must be an identity for combine (0 for +, 1 for *, an empty vector for
+// concatenation), and combine must be associative. op and combine are called from several
+// threads at once, and must be safe to so call; each piece folds with its own copy of op,
+// and puts two together with its own copy of combine, so callables which count their calls
+// per copy, as probed ones do (see Probe.h), may be passed. If either throws, the first exception is
+// rethrown on the calling thread, once every piece already started has ended.
+//
+// Only random access iterators ending in an iterator of the same type are split, which
+// covers Map, Take, Drop and Zip over vectors and each other, and Take over a Progression.
+// Anything else is folded on the calling thread, as by Fold.
+//
+// Create using ParallelFold(), below.
+//
+
+// Usage example:
+//
+// std::vector<int> v(1000000, 1);
+// auto vm = FIter::Map([](int x){ return x * 2; })(v.begin(), v.end());
+// auto plus = [](long a, long b){ return a + b; };
+// std::cout << FIter::ParallelFold(0L, plus, plus)(vm);
+//
+// This will print '2000000'.
+
+// Pieces are at least this long by default, so that each task has enough work to pay for
+// being queued and stolen.
+const std::ptrdiff_t default_grain = 1 << 14;
+
+template <typename IterT, typename ValueT, typename func, typename combinef>
+ValueT _parallel_fold(ThreadPool& pool, const IterT& begin, const IterT& end, const ValueT& init, const func& op, combinef combine, std::ptrdiff_t grain) {
+  std::ptrdiff_t n = end - begin;
+  if(n <= grain || pool.size() == 1) {
+    FITER_TRACE("ParallelFold piece");
+    return FoldOn<ValueT, func>(init, op)(begin, end);
+  }
+  IterT mid = begin + n / 2;
+  ValueT right = init;
+  auto fold_right = [&] { right = _parallel_fold(pool, mid, end, init, op, combine, grain); };
+  TaskGroup g(pool);
+  g.spawn(std::ref(fold_right)); // waited on below
+  ValueT left = _parallel_fold(pool, begin, mid, init, op, combine, grain);
+  g.wait();
+  return combine(std::move(left), std::move(right));
+}
+
+
+// Stores an initial value, a fold function and a combining function. When called on a
+// pair of iterators or an object, returns the fold of its items, computed in parallel.
+// Its purposes are to allow currying and implicit template instantiation.
+template <typename ValueT, typename func, typename combinef>
+struct ParallelFoldOn {
+  ValueT init;
+  func op;
+  combinef combine;
+  ThreadPool* pool;
+  std::ptrdiff_t grain;
+
+  ParallelFoldOn(ValueT _init, func _op, combinef _combine, ThreadPool* _pool, std::ptrdiff_t _grain) :
+    init(_init), op(_op), combine(_combine), pool(_pool), grain(_grain > 0 ? _grain : 1) {}
+
+  template <typename IterT, typename SentT>
+  ValueT operator() (IterT start, SentT end) const {
+    if constexpr (is_random_access<IterT>::value && std::is_same<IterT, SentT>::value)
+      return _parallel_fold(pool ? *pool : ThreadPool::shared(), start, end, init, op, combine, grain);
+    else
+      return FoldOn<ValueT, func>(init, op)(start, end);
+  }
+
+  template <typename Range>
+  ValueT operator() (const Range& r) const {
+    return (*this)(r.begin(), r.end());
+  }
+};
+
+
+
+// ParallelFold takes an initial value, a fold function and a combining function, and
+// optionally a pool and a grain size, and returns a ParallelFoldOn<> storing them.
+// Callable objects are stored as they are; functions decay to function pointers.
+template<typename ValueT, typename F, typename C>
+ParallelFoldOn<ValueT, F, C> ParallelFold(ValueT init, F op, C combine, ThreadPool& pool, std::ptrdiff_t grain = default_grain) {
+  return ParallelFoldOn<ValueT, F, C>(init, op, combine, &pool, grain);
+}
+
+template<typename ValueT, typename F, typename C>
+ParallelFoldOn<ValueT, F, C> ParallelFold(ValueT init, F op, C combine) {
+  return ParallelFoldOn<ValueT, F, C>(init, op, combine, nullptr, default_grain);
+}
+
+
+
+
+
+
+
+// A parallel 'collecting' terminal.
+//
+// Like Collect, but for sequences which can be split by position (see _slice in FIter.h),
+// which include Filters, Maps and chains of them over vectors, as well as everything
+// ParallelFold can split. The positions are split into pieces of at least 'grain', a few
+// for each thread of the pool (by default ThreadPool::shared()), and then:
+//
+//  1. each piece's items are counted, in parallel;
+//  2. the counts are added up in order, giving where each piece's items go;
+//  3. the container is made, once, at its final size, and each piece writes its items
+//     into its place, in parallel.
+//
+// So the items end up in the same order as Collect would put them, and every function in
+// the pipeline is called twice per item (once to count, once to write), from several
+// threads at once. If one throws, the first exception is rethrown on the calling thread,
+// once every piece already started has ended.
+//
+// Container must be constructible with a size, with random access iterators, as vector
+// and deque are. Sequences which can't be split are collected on the calling thread, as by
+// Collect.
+//
+
+// Usage example:
+//
+// std::vector<int> v(1000000);
+// auto vf = FIter::Filter([](int x){ return x % 3 == 0; })(v.begin(), v.end());
+// auto c = FIter::ParallelCollect<std::vector<int>>()(vf);
+
+template <typename Container>
+struct ParallelCollect {
+  ThreadPool* pool;
+  std::ptrdiff_t grain;
+
+  ParallelCollect() : pool(nullptr), grain(default_grain) {}
+  explicit ParallelCollect(ThreadPool& _pool, std::ptrdiff_t _grain = default_grain) : pool(&_pool), grain(_grain > 0 ? _grain : 1) {}
+
+  template <typename IterT, typename SentT>
+  Container operator() (IterT start, SentT end) const {
+    if constexpr (is_sliceable<IterT, SentT>::value) {
+      ThreadPool& p = pool ? *pool : ThreadPool::shared();
+      std::ptrdiff_t length = _slice_length(start, end, 0);
+      std::ptrdiff_t pieces = std::min<std::ptrdiff_t>(length / grain, 4 * p.size());
+      if(pieces <= 1)
+        return Collect<Container>()(start, end);
+
+      auto piece = [&](std::ptrdiff_t k) { return _slice(start, end, length * k / pieces, length * (k + 1) / pieces, 0); };
+
+      std::vector<std::ptrdiff_t> offsets(pieces + 1, 0);
+      {
+        TaskGroup g(p);
+        for(std::ptrdiff_t k = 0; k < pieces; ++k)
+          g.spawn([&, k] {
+            FITER_TRACE("ParallelCollect count");
+            auto r = piece(k);
+            std::ptrdiff_t n = 0;
+            _for_each(r.first, r.second, [&n](auto&&) { ++n; return true; });
+            offsets[k + 1] = n;
+          });
+        g.wait();
+      }
+      std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+      Container c(offsets[pieces]);
+      {
+        TaskGroup g(p);
+        for(std::ptrdiff_t k = 0; k < pieces; ++k)
+          g.spawn([&, k] {
+            FITER_TRACE("ParallelCollect copy");
+            auto r = piece(k);
+            auto out = c.begin() + offsets[k];
+            _for_each(r.first, r.second, [&out](auto&& x) { *out = std::forward<decltype(x)>(x); ++out; return true; });
+          });
+        g.wait();
+      }
+      return c;
+    }
+    else
+      return Collect<Container>()(start, end);
+  }
+
+  template <typename Range>
+  Container operator() (const Range& r) const {
+    return (*this)(r.begin(), r.end());
+  }
+};
+
+
+
+}
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "FIter.h"
+#include "Drop.h"
+#include "Filter.h"
+#include "Map.h"
+#include "MapFilter.h"
+#include "Take.h"
+
+namespace FIter {
+
+
+// Pipe composition, with fusion.
+//
+// The point of this file. 'r | b', for a range r (anything with begin() and end(): a
+// container, or any FIter object) and anything b which can be called on a pair of
+// iterators (Map(f), Filter(f), Take(n), etc., and the terminals Fold, Collect and
+// ForEach), is b(r.begin(), r.end()). So a pipeline can be written in the order it runs,
+// as 'v | Filter(f) | Map(g) | Take(n)'.
+//
+// Where two adjacent stages can be done as one, they are, when the types are known at
+// compile time:
+//
+//   Filter(f) | Filter(g)   is a Filter of 'f(x) && g(x)'
+//   Map(f) | Map(g)         is a Map of 'g(f(x))'
+//   Map(f) | Filter(g)      is a MapFilter (see MapFilter.h), which calls f once per item
+//   MapFilter | Filter(g)   is a MapFilter, testing both
+//   Take(n) | Take(m)       is a Take of the lesser of n and m
+//   Drop(n) | Drop(m)       is a Drop of n + m
+//
+// So each stage of a long chain of the same kind doesn't add a loop, an end check and a
+// stored end iterator per item, as nesting them does. The items are the same either way.
+// (Filters fused this way lose the SIMD path of Simd.h, which only knows single Compare.h
+// comparisons.)
+//
+// The range on the left must outlive what is built from it, as for iterators taken from
+// it. So a container can't be a temporary, and nor can an object which owns what its
+// iterators point into: a MmapRange (its mapping), a LineReader (its buffer) or a Chain
+// over many ranges (its list of segments). These are rejected at compile time. Other FIter
+// objects can, since their iterators carry what they need, or share it (Cache its table
+// and Prefetch its channel); the containers under them must still outlive the result.
+//
+
+// Usage example:
+//
+// std::vector<int> v{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+// for(auto x : v | FIter::Filter(mod2) | FIter::Filter(mod3) | FIter::Map(square))
+//   std::cout << x << ",";
+//
+// This will print '0,36,144,', assuming 'mod2', 'mod3' and 'square' are defined
+// appropriately, with one Filter loop testing both predicates.
+
+// The conjunction of two predicates.
+template <typename F, typename G>
+struct Both {
+  F f;
+  G g;
+
+  template <typename T>
+  constexpr bool operator()(const T& x) const { return f(x) && g(x); }
+};
+
+// The composition of two functions: f, then g.
+template <typename F, typename G>
+struct Composed {
+  F f;
+  G g;
+
+  template <typename T>
+  constexpr auto operator()(T&& x) const -> decltype(g(f(std::forward<T>(x)))) { return g(f(std::forward<T>(x))); }
+};
+
+
+
+
+
+
+
+// Builds fused stages from the insides of the stages being fused, which name it a friend.
+struct Fusion {
+  template <typename IterT, typename F, typename SentT, typename G>
+  static constexpr FilteredObject<IterT, Both<F, G>, SentT> filter(const FilteredObject<IterT, F, SentT>& r, const G& g) {
+    return FilteredObject<IterT, Both<F, G>, SentT>(r.m_begin, r.m_end, Both<F, G>{r.filter, g});
+  }
+
+  template <typename IterT, typename F, typename SentT, typename G>
+  static constexpr MapObject<IterT, Composed<F, G>, SentT> map(const MapObject<IterT, F, SentT>& r, const G& g) {
+    return MapObject<IterT, Composed<F, G>, SentT>(r.m_begin, r.m_end, Composed<F, G>{r.mapf, g});
+  }
+
+  template <typename IterT, typename F, typename SentT, typename G>
+  static MapFilterObject<IterT, F, G, SentT> filter(const MapObject<IterT, F, SentT>& r, const G& g) {
+    return MapFilterObject<IterT, F, G, SentT>(r.m_begin, r.m_end, r.mapf, g);
+  }
+
+  template <typename IterT, typename M, typename F, typename SentT, typename G>
+  static MapFilterObject<IterT, M, Both<F, G>, SentT> filter(const MapFilterObject<IterT, M, F, SentT>& r, const G& g) {
+    return MapFilterObject<IterT, M, Both<F, G>, SentT>(r.m_begin, r.m_end, r.m_fns.map, Both<F, G>{r.m_fns.test, g});
+  }
+
+  template <typename IterT, typename SentT>
+  static constexpr TakeObject<IterT, SentT> take(const TakeObject<IterT, SentT>& r, long n) {
+    return TakeObject<IterT, SentT>(r.m_begin, r.m_end, std::min(r.to_take, n));
+  }
+
+  template <typename IterT, typename SentT>
+  static constexpr DropObject<IterT, SentT> drop(const DropObject<IterT, SentT>& r, long n) {
+    return DropObject<IterT, SentT>(r.m_begin, r.m_end, std::max(r.to_drop, 0L) + std::max(n, 0L));
+  }
+};
+
+
+
+
+
+
+
+// The general case: b(r.begin(), r.end()).
+template <typename Range, typename Builder, typename = typename std::enable_if<is_range<const Range>::value>::type>
+constexpr auto operator|(const Range& r, Builder b) -> decltype(b(r.begin(), r.end())) {
+  return b(r.begin(), r.end());
+}
+
+// Temporaries which own their items (see owns_items in FIter.h) are rejected, as chosen
+// over the general case for rvalues.
+template <typename Range, typename Builder, typename = typename std::enable_if<!std::is_reference<Range>::value && owns_items<Range>::value>::type>
+void operator|(Range&&, Builder) {
+  static_assert(!owns_items<Range>::value, "the result of '|' keeps only the range's iterators, so the range can't be a temporary which owns its items (a container, MmapRange, LineReader or Chain over many ranges): name it first");
+}
+
+// The fused cases, chosen over the general one as more specialised.
+template <typename IterT, typename F, typename SentT, typename G>
+constexpr auto operator|(const FilteredObject<IterT, F, SentT>& r, FilterOn<G> b) {
+  return Fusion::filter(r, b.f);
+}
+
+template <typename IterT, typename F, typename SentT, typename G>
+constexpr auto operator|(const MapObject<IterT, F, SentT>& r, MapOn<G> b) {
+  return Fusion::map(r, b.f);
+}
+
+template <typename IterT, typename F, typename SentT, typename G>
+constexpr auto operator|(const MapObject<IterT, F, SentT>& r, FilterOn<G> b) {
+  return Fusion::filter(r, b.f);
+}
+
+template <typename IterT, typename M, typename F, typename SentT, typename G>
+constexpr auto operator|(const MapFilterObject<IterT, M, F, SentT>& r, FilterOn<G> b) {
+  return Fusion::filter(r, b.f);
+}
+
+template <typename IterT, typename SentT>
+constexpr auto operator|(const TakeObject<IterT, SentT>& r, Take b) {
+  return Fusion::take(r, b.n);
+}
+
+template <typename IterT, typename SentT>
+constexpr auto operator|(const DropObject<IterT, SentT>& r, Drop b) {
+  return Fusion::drop(r, b.n);
+}
+
+
+
+
+
+}
+
+#endif
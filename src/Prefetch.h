@@ -0,0 +1,253 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <utility>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// A prefetching iterator.
+//
+// The point of this file. Given a pair of iterators of type IterT, it can create input
+// iterators (a nested subtype) over the same items. However, the original iterators are
+// driven on a thread of their own, started by begin(), which passes their items through a
+// ring buffer holding up to 'capacity' items: so an expensive upstream (parsing, decoding)
+// runs while the downstream works on what it has already produced.
+//
+// The buffer has a single producer and a single consumer, and takes no locks. Each side
+// keeps its place to itself and only publishes it to the other a batch (a quarter of the
+// buffer) at a time, or when it has to wait, so the two threads don't pass the cache line
+// holding it back and forth on every item. A side with nothing to do yields its thread.
+// The producer pushes the items into the buffer with internal iteration (see _for_each in
+// FIter.h), so the upstream runs as its own tight loop.
+//
+// An exception thrown by the upstream is caught on the producer's thread, and thrown again
+// on the consumer's, when it reaches the point at which the upstream threw. When the last
+// iterator from a begin() is destroyed, the producer is told to stop, and joined: so a
+// Take, TakeWhile, etc. after a Prefetch shuts it down cleanly as soon as it's done. (The
+// producer stops as soon as it next publishes a batch, or finds the buffer full: so after
+// at most a batch more of the upstream's items. An upstream blocked in a read holds that
+// up.)
+//
+// Items are moved into the buffer, and must be default constructible, as for batches.
+// They mustn't refer into a buffer of the upstream's own which it reuses (as LineReader's
+// string_views do): the producer is ahead of the consumer, so Map them to something which
+// owns its contents first. The upstream's functions run on the producer's thread.
+//
+// Each begin() runs the upstream afresh, on a new thread. end() is an empty sentinel.
+//
+// With tracing on (see Trace.h), the producer's run, and each time either side has to
+// wait for the other, are traced.
+//
+// Create using Prefetch(), below.
+//
+
+// Usage example:
+//
+// FIter::LineReader log("server.log");
+// auto parsed = FIter::Map(parse_record)(log.begin(), log.end());
+// auto ahead = FIter::Prefetch(4096)(parsed.begin(), parsed.end());
+// for(auto& r : ahead)
+//   aggregate(r);
+//
+// This will parse records on one thread while aggregating them on another.
+
+template<typename IterT, typename SentT = IterT>
+class PrefetchObject {
+
+  typedef typename std::decay<decltype(*std::declval<IterT>())>::type value_type;
+
+  // The state shared by the producer and the consumer. Each side's own fields are on cache
+  // lines of their own, so that neither's work slows the other's.
+  struct Channel {
+    std::unique_ptr<value_type[]> items;
+    std::size_t mask; // capacity - 1, a power of 2
+    std::size_t batch;
+
+    // Written by the producer.
+    alignas(64) std::atomic<std::size_t> tail; // items published
+    std::atomic<bool> done;
+    std::exception_ptr error;
+
+    // Written by the consumer.
+    alignas(64) std::atomic<std::size_t> head; // items published as consumed
+    std::atomic<bool> stop;
+
+    // The producer's own.
+    alignas(64) std::size_t produced;
+    std::size_t head_seen;
+
+    // The consumer's own.
+    alignas(64) std::size_t consumed;
+    std::size_t tail_seen;
+    bool at_end;
+
+    std::thread producer;
+
+    Channel(std::size_t capacity) : tail(0), done(false), head(0), stop(false),
+      produced(0), head_seen(0), consumed(0), tail_seen(0), at_end(false)
+    {
+      std::size_t n = 2;
+      while(n < capacity) n *= 2;
+      items.reset(new value_type[n]);
+      mask = n - 1;
+      batch = n / 4 > 0 ? n / 4 : 1;
+    }
+
+    ~Channel() {
+      stop.store(true, std::memory_order_relaxed);
+      if(producer.joinable()) producer.join();
+    }
+
+    // Producer side. Runs the upstream into the buffer.
+    void produce(IterT b, SentT e) {
+      trace_thread_name("Prefetch producer");
+      FITER_TRACE("Prefetch producer");
+      try {
+        _for_each(b, e, [this](auto&& x) {
+          if(produced - head_seen > mask && !wait_for_room()) return false;
+          items[produced & mask] = std::forward<decltype(x)>(x);
+          if(++produced - tail.load(std::memory_order_relaxed) >= batch) {
+            tail.store(produced, std::memory_order_release);
+            if(stop.load(std::memory_order_relaxed)) return false;
+          }
+          return true;
+        });
+      }
+      catch(...) {
+        error = std::current_exception();
+      }
+      tail.store(produced, std::memory_order_release);
+      done.store(true, std::memory_order_release);
+    }
+
+    // Returns false if the consumer has stopped.
+    bool wait_for_room() {
+      FITER_TRACE("Prefetch: buffer full");
+      tail.store(produced, std::memory_order_release); // so that it can't be waiting on us
+      while(true) {
+        if(stop.load(std::memory_order_relaxed)) return false;
+        head_seen = head.load(std::memory_order_acquire);
+        if(produced - head_seen <= mask) return true;
+        std::this_thread::yield();
+      }
+    }
+
+    // Consumer side. Moves on to the next item, or to the end.
+    void next() {
+      ++consumed;
+      if(consumed - head.load(std::memory_order_relaxed) >= batch)
+        head.store(consumed, std::memory_order_release);
+      fetch();
+    }
+
+    // Waits for the current item, or for the producer to finish.
+    void fetch() {
+      if(consumed != tail_seen) return;
+      FITER_TRACE("Prefetch: waiting for items");
+      head.store(consumed, std::memory_order_release);
+      while(true) {
+        bool finished = done.load(std::memory_order_acquire); // before tail, which it follows
+        tail_seen = tail.load(std::memory_order_acquire);
+        if(consumed != tail_seen) return;
+        if(finished) {
+          at_end = true;
+          if(error) std::rethrow_exception(error);
+          return;
+        }
+        std::this_thread::yield();
+      }
+    }
+  };
+
+ protected:
+  const IterT m_begin;
+  const SentT m_end;
+  const std::size_t m_capacity;
+
+
+ public:
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<std::input_iterator_tag, value_type>,
+  public Iterator_base<std::input_iterator_tag, const_iterator, value_type>
+  {
+    std::shared_ptr<Channel> m_cur;
+
+    const value_type& access() const { return m_cur->items[m_cur->consumed & m_cur->mask]; }
+
+    const value_type& operator*() const { return access(); }
+    const value_type* operator->() const { return &access(); }
+
+    void advance() { m_cur->next(); }
+
+    bool reached(const sentinel&) const { return m_cur->at_end; }
+
+    explicit const_iterator(const std::shared_ptr<Channel>& _cur) : m_cur(_cur)
+    {}
+  };
+
+
+  PrefetchObject(IterT _begin, SentT _end, std::size_t _capacity) : m_begin(_begin), m_end(_end), m_capacity(_capacity)
+  {}
+
+  // Starts the producer, and waits for the first item.
+  const_iterator begin() const {
+    auto channel = std::make_shared<Channel>(m_capacity);
+    Channel* c = channel.get();
+    c->producer = std::thread([c, b = m_begin, e = m_end] { c->produce(b, e); });
+    c->fetch();
+    return const_iterator(channel);
+  }
+
+  sentinel end() const {
+    return sentinel();
+  }
+};
+
+
+
+
+
+
+
+// Stores a capacity. When called on a pair of iterators, returns a PrefetchObject which
+// iterates over them on a thread of its own.
+// Its purposes are to allow currying and implicit template instantiation.
+struct PrefetchOn {
+  std::size_t capacity;
+
+  PrefetchOn(std::size_t _capacity) : capacity(_capacity) {}
+
+  template <typename IterT, typename SentT>
+  PrefetchObject<IterT, SentT> operator() (IterT start, SentT end) {
+    return PrefetchObject<IterT, SentT>(start, end, capacity);
+  }
+};
+
+
+
+
+
+
+
+// Prefetch takes the number of items to buffer (rounded up to a power of 2; by default
+// enough for a few batches of default_batch_size) and returns a PrefetchOn storing it.
+inline PrefetchOn Prefetch(std::size_t capacity = 4 * default_batch_size) {
+  return PrefetchOn(capacity);
+}
+
+
+
+
+
+}
+
+#endif
@@ -0,0 +1,721 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// Instrumentation probes.
+//
+// The point of this file. Probe(name), placed between two stages like any other, passes
+// on the items it is given, counting them and timing (one in probe_sample_period of) the
+// work done upstream to produce them. Probe(name, f) wraps the callable of a Map, Filter,
+// TakeWhile, etc., counting its calls and timing them, and for predicates, counting how
+// many it passes. Each probe adds to the totals kept under its name, which probe_report()
+// returns as a tree, in which the probes found upstream of a stage probe (through the
+// iterators it wraps, and their callables) are its children: so a pipeline's report has
+// its shape, and each stage's own time can be told from that of the stages before it.
+//
+// Probes are only compiled in when FITER_PROBES is defined. Otherwise Probe(name) passes
+// on the iterators it is given unchanged, and Probe(name, f) returns f itself, so probes
+// can be left in place in production code at no cost at all.
+//
+// Counts are kept by each iterator and callable, and added to its probe's totals when it
+// is destroyed, or when a push (see _for_each in FIter.h) finishes; so pipelines may be
+// run on several threads at once, as by ParallelFold, and the totals are complete once
+// they are done. A single iterator or callable, though, mustn't be used from two threads
+// at once: ParallelFold, for one, gives each piece its own copies of op and combine. (The iterators kept by the objects of a pipeline, for their begin()s,
+// aren't done until the objects are: a Filter's, for instance, has already called its
+// predicate once.) Time is measured with std::chrono::steady_clock, and includes the
+// probes' own overhead upstream, so is best compared between runs with the same probes.
+//
+
+// Usage example:
+//
+// auto nums = FIter::Probe("source")(v.begin(), v.end());
+// auto small = FIter::Filter(FIter::Probe("x < 500", [](int x){ return x < 500; }))(nums.begin(), nums.end());
+// auto squares = FIter::Probe("squares")(small.begin(), small.end());
+// FIter::Fold(0L, std::plus<long>())(squares);
+// FIter::print_probes(std::cout);
+//
+// This will print something like
+//
+// squares                         500 items   of 1000 in (50.0%)    2.10 ns/item, 0.85 own
+//   x < 500                      1000 calls   500 true (50.0%)      0.48 ns/call
+//   source                       1000 items                          0.12 ns/item, 0.12 own
+//
+// when compiled with FITER_PROBES, and nothing otherwise.
+
+#ifdef FITER_PROBES
+const bool probes_enabled = true;
+#else
+const bool probes_enabled = false;
+#endif
+
+// One item (or call) in this many is timed. Reading the clock costs tens of nanoseconds,
+// more than many stages do per item.
+const long probe_sample_period = 64;
+
+
+
+
+
+
+
+// A probe's totals, kept under its name. Nodes are never freed, so that iterators can hold
+// pointers to them.
+struct Probe_node {
+  std::string name;
+  bool is_callable;
+  std::atomic<bool> is_predicate{false};
+  std::atomic<long> items{0}; // items passed on, or calls made
+  std::atomic<long> passed{0}; // calls returning true
+  std::atomic<long> sampled{0}; // items, or calls, timed
+  std::atomic<long> ns{0}; // time taken by those
+
+  std::vector<Probe_node*> children; // guarded by the registry's mutex
+
+  Probe_node(const std::string& _name, bool _is_callable) : name(_name), is_callable(_is_callable)
+  {}
+};
+
+struct Probe_registry {
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<Probe_node>> nodes;
+  std::vector<Probe_node*> order; // by creation
+};
+
+inline Probe_registry& _probe_registry() {
+  static Probe_registry registry;
+  return registry;
+}
+
+inline Probe_node* _probe_node(const char* name, bool is_callable) {
+  Probe_registry& r = _probe_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto& node = r.nodes[name];
+  if(!node) {
+    node.reset(new Probe_node(name, is_callable));
+    r.order.push_back(node.get());
+  }
+  return node.get();
+}
+
+inline void _probe_link(Probe_node* parent, const std::vector<Probe_node*>& children) {
+  Probe_registry& r = _probe_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for(Probe_node* c : children)
+    if(c != parent && std::find(parent->children.begin(), parent->children.end(), c) == parent->children.end())
+      parent->children.push_back(c);
+}
+
+// The counts of a single iterator or callable, not yet added to its probe's.
+struct Probe_counts {
+  long items = 0;
+  long passed = 0;
+  long sampled = 0;
+  long ns = 0;
+  bool is_predicate = false;
+
+  void flush_to(Probe_node* node) {
+    if(!node || items == 0) return;
+    node->items.fetch_add(items, std::memory_order_relaxed);
+    node->passed.fetch_add(passed, std::memory_order_relaxed);
+    node->sampled.fetch_add(sampled, std::memory_order_relaxed);
+    node->ns.fetch_add(ns, std::memory_order_relaxed);
+    if(is_predicate) node->is_predicate.store(true, std::memory_order_relaxed);
+    *this = Probe_counts();
+  }
+};
+
+// Timers started so far on this thread.
+inline long& _probe_timers_started() {
+  thread_local long n = 0;
+  return n;
+}
+
+// Times from its construction. Reading the clock costs more than many intervals last, so
+// that cost is taken off: as measured there and then, by reading the clock a second time
+// straight after the first (a cost measured once, up front, is that of a clock already hot
+// in the cache, and leaves much of it in). So is that of the timers started in the
+// meantime, by the probes upstream, which read it three times each; otherwise a stage would
+// be charged for its children's clock. Short intervals can so come out negative; they are
+// added up as they are, so that their errors cancel, and only totals are kept from going
+// below zero.
+struct Probe_timer {
+  long index = _probe_timers_started()++;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  long elapsed() const {
+    auto end = std::chrono::steady_clock::now();
+    long reading = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - end).count();
+    long nested = _probe_timers_started() - index - 1;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() - reading * (1 + 3 * nested);
+  }
+};
+
+
+
+
+
+
+
+// Finds the probes directly upstream of an iterator: the iterator itself, if it is a
+// probe's; otherwise any probed callable it holds, and the probes upstream of the
+// iterators it wraps, found through their m_cur members (m_cur_1 and m_cur_2 for Zip, and
+// each of a tuple of them for ZipNObject). Iterators which aren't FIter's wrap nothing.
+// (Same overloading technique as _get_base in FIter.h.)
+template <class T>
+void _find_probes(const T& it, std::vector<Probe_node*>& found);
+
+template <class... T>
+void _find_probes(const std::tuple<T...>& its, std::vector<Probe_node*>& found) {
+  std::apply([&](const T&... it) { (_find_probes(it, found), ...); }, its);
+}
+
+template <class T>
+auto _find_probe_here(const T& it, std::vector<Probe_node*>& found, int) -> decltype(void(it.probe_node()), bool()) {
+  found.push_back(it.probe_node());
+  return true;
+}
+
+template <class T>
+bool _find_probe_here(const T&, std::vector<Probe_node*>&, long) {
+  return false;
+}
+
+template <class T>
+auto _find_probe_fn(const T& it, std::vector<Probe_node*>& found, int) -> decltype(void(it.fn().probe_node())) {
+  found.push_back(it.fn().probe_node());
+}
+
+template <class T>
+void _find_probe_fn(const T&, std::vector<Probe_node*>&, long) {}
+
+template <class T>
+auto _find_probes_in(const T& it, std::vector<Probe_node*>& found, int) -> decltype(void(it.m_cur)) {
+  _find_probes(it.m_cur, found);
+}
+
+template <class T>
+auto _find_probes_in(const T& it, std::vector<Probe_node*>& found, long) -> decltype(void(it.m_cur_1), void(it.m_cur_2)) {
+  _find_probes(it.m_cur_1, found);
+  _find_probes(it.m_cur_2, found);
+}
+
+template <class T>
+void _find_probes_in(const T&, std::vector<Probe_node*>&, ...) {}
+
+template <class T>
+void _find_probes(const T& it, std::vector<Probe_node*>& found) {
+  if constexpr (std::is_class<T>::value) {
+    if(_find_probe_here(it, found, 0)) return;
+    _find_probe_fn(it, found, 0);
+    _find_probes_in(it, found, 0);
+  }
+}
+
+
+
+
+
+
+
+#ifdef FITER_PROBES
+
+// A probed callable. Copies count their own calls, so that each iterator's copy can be
+// used without locking; they are added to the probe's totals when the copy is destroyed.
+// It can't be assigned (Function_base rebuilds it instead, which does the same).
+template <class F>
+class Probed {
+  F m_f;
+  Probe_node* m_node;
+  mutable Probe_counts m_counts;
+
+ public:
+  Probed(const F& _f, Probe_node* _node) : m_f(_f), m_node(_node)
+  {}
+
+  Probed(const Probed& r) : m_f(r.m_f), m_node(r.m_node)
+  {}
+
+  Probed& operator=(const Probed&) = delete;
+
+  ~Probed() {
+    m_counts.flush_to(m_node);
+  }
+
+  Probe_node* probe_node() const { return m_node; }
+
+  template <class... Args>
+  auto operator()(Args&&... args) const -> decltype(std::declval<const F&>()(std::forward<Args>(args)...)) {
+    typedef decltype(m_f(std::forward<Args>(args)...)) result_type;
+    bool timed = (m_counts.items++ % probe_sample_period == 0);
+    if constexpr (std::is_void<result_type>::value) {
+      if(!timed) return m_f(std::forward<Args>(args)...);
+      Probe_timer t;
+      m_f(std::forward<Args>(args)...);
+      sampled(t);
+    }
+    else {
+      if(!timed) return counted<result_type>(m_f(std::forward<Args>(args)...));
+      Probe_timer t;
+      result_type r = m_f(std::forward<Args>(args)...);
+      sampled(t);
+      return counted<result_type>(std::forward<result_type>(r));
+    }
+  }
+
+ private:
+  void sampled(const Probe_timer& t) const {
+    m_counts.ns += t.elapsed();
+    ++m_counts.sampled;
+  }
+
+  // Predicates' results are counted.
+  template <class R>
+  R counted(R r) const {
+    if constexpr (std::is_same<typename std::decay<R>::type, bool>::value) {
+      m_counts.is_predicate = true;
+      if(r) ++m_counts.passed;
+    }
+    return r;
+  }
+};
+
+
+
+// A probing iterator.
+//
+// Given a pair of iterators of type IterT, it can create iterators (a nested subtype)
+// exporting all constant functions of the original iterators, and returning the same
+// items; however, these iterators count the items they pass, and time the work the
+// originals do to produce them. Since the original iterators may be a whole pipeline,
+// that's the time of every stage upstream.
+//
+// end() is a const_iterator when SentT is IterT, an Unreachable when SentT is, and
+// otherwise a sentinel wrapping the original one. Sized pairs give sized iterators, and
+// size(), as for Map. Pushes (see _for_each in FIter.h) pass straight through, timing the
+// whole push less the time spent downstream.
+//
+// Create using Probe(name), below.
+template<typename IterT, typename SentT = IterT>
+class ProbeObject {
+
+  typedef typename std::decay<decltype(*std::declval<IterT>())>::type value_type;
+  typedef typename std::iterator_traits<IterT>::iterator_category iterator_category;
+
+ protected:
+  const IterT m_begin;
+  const SentT m_end;
+
+  Probe_node* m_node;
+
+
+ public:
+  struct sentinel {
+    SentT m_end;
+  };
+
+  struct const_iterator : public Iterator_types<iterator_category, value_type>,
+  public Iterator_base<iterator_category, const_iterator, value_type>
+  {
+    IterT m_cur;
+    Probe_node* m_node;
+    mutable Probe_counts m_counts;
+
+    auto get_base() -> decltype(_get_base<IterT>(m_cur, 0)) {
+      return _get_base<IterT>(m_cur, 0);
+    }
+
+    Probe_node* probe_node() const { return m_node; }
+
+    // Sampled items are timed, along with the advance from them, out of line, so that the
+    // rest are as cheap as can be.
+    value_type access() const {
+      if(m_counts.items % probe_sample_period != 0)
+        return *m_cur;
+      return timed_access();
+    }
+
+    void advance() {
+      if(m_counts.items++ % probe_sample_period != 0)
+        ++m_cur;
+      else
+        timed_advance();
+    }
+
+    value_type timed_access() const {
+      Probe_timer t;
+      value_type x = *m_cur;
+      m_counts.ns += t.elapsed();
+      return x;
+    }
+
+    void timed_advance() {
+      Probe_timer t;
+      ++m_cur;
+      m_counts.ns += t.elapsed();
+      ++m_counts.sampled;
+    }
+
+    void unadvance() {
+      --m_cur;
+    }
+
+    // Jumps pass no items on.
+    void advance(std::ptrdiff_t n) {
+      m_cur += n;
+    }
+
+    std::ptrdiff_t distance_from(const const_iterator& r) const {
+      return m_cur - r.m_cur;
+    }
+
+    bool reached(const sentinel& s) const {
+      return m_cur == s.m_end;
+    }
+
+    template <class S = SentT>
+    auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t(std::declval<const S&>() - m_cur)) {
+      return s.m_end - m_cur;
+    }
+
+    // Internal iteration. The time spent downstream (in the sink) is sampled, and taken
+    // off the time of the whole push.
+    static const IterT& end_of(const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const sentinel& e) { return e.m_end; }
+    static Unreachable end_of(Unreachable) { return Unreachable(); }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      Probe_counts counts;
+      long downstream_ns = 0, downstream_sampled = 0;
+      Probe_timer whole;
+      bool more = _for_each(b.m_cur, end_of(e), [&](auto&& x) {
+        if(counts.items++ % probe_sample_period != 0)
+          return sink(std::forward<decltype(x)>(x));
+        Probe_timer t;
+        bool r = sink(std::forward<decltype(x)>(x));
+        downstream_ns += t.elapsed();
+        ++downstream_sampled;
+        return r;
+      });
+      long ns = whole.elapsed();
+      if(downstream_sampled > 0)
+        ns -= (long)((double)downstream_ns * counts.items / downstream_sampled);
+      counts.ns = ns > 0 ? ns : 0;
+      counts.sampled = counts.items;
+      counts.flush_to(b.m_node);
+      return more;
+    }
+
+    // The same, a block at a time. Every block is timed downstream: the clock is read
+    // twice per block, not per item.
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(e), bool()) {
+      Probe_counts counts;
+      long downstream_ns = 0;
+      Probe_timer whole;
+      bool more = _for_each_batch<N>(b.m_cur, end_of(e), [&](auto* items, std::size_t n) {
+        counts.items += n;
+        Probe_timer t;
+        bool r = sink(items, n);
+        downstream_ns += t.elapsed();
+        return r;
+      });
+      long ns = whole.elapsed() - downstream_ns;
+      counts.ns = ns > 0 ? ns : 0;
+      counts.sampled = counts.items;
+      counts.flush_to(b.m_node);
+      return more;
+    }
+
+    // Splitting by position: see _slice in FIter.h. Positions are those of the original
+    // iterators.
+    template <class It = const_iterator>
+    static auto slice_length(const It& b, const It& e) -> decltype(_slice_length(b.m_cur, e.m_cur, 0)) {
+      return _slice_length(b.m_cur, e.m_cur, 0);
+    }
+
+    template <class It = const_iterator>
+    static auto slice(const It& b, const It& e, std::ptrdiff_t lo, std::ptrdiff_t hi) -> decltype(_slice(b.m_cur, e.m_cur, lo, hi, 0), std::pair<It, It>(b, e)) {
+      auto inner = _slice(b.m_cur, e.m_cur, lo, hi, 0);
+      return std::make_pair(const_iterator(inner.first, b.m_node), const_iterator(inner.second, b.m_node));
+    }
+
+
+    // Copies start counting afresh, so that nothing is counted twice.
+    const_iterator(const IterT& _cur, Probe_node* _node) : m_cur(_cur), m_node(_node)
+    {}
+
+    const_iterator(const const_iterator& r) : m_cur(r.m_cur), m_node(r.m_node)
+    {}
+
+    const_iterator& operator=(const const_iterator& r)
+    { m_counts.flush_to(m_node); m_cur = r.m_cur; m_node = r.m_node; return *this; }
+
+    ~const_iterator() {
+      m_counts.flush_to(m_node);
+    }
+  };
+
+
+  // Makes the probes upstream of this one its children.
+  ProbeObject(IterT _begin, SentT _end, Probe_node* _node) : m_begin(_begin), m_end(_end), m_node(_node)
+  {
+    std::vector<Probe_node*> found;
+    _find_probes(m_begin, found);
+    _probe_link(m_node, found);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(m_begin, m_node);
+  }
+
+  auto end() const {
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, m_node);
+    else if constexpr (std::is_same<SentT, Unreachable>::value)
+      return Unreachable();
+    else
+      return sentinel{m_end};
+  }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value>::type>
+  std::ptrdiff_t size() const {
+    return _length(m_begin, m_end);
+  }
+};
+
+#else
+
+// With probes compiled out, a ProbeObject is just the pair of iterators it was given.
+template<typename IterT, typename SentT = IterT>
+class ProbeObject {
+ protected:
+  const IterT m_begin;
+  const SentT m_end;
+
+ public:
+  ProbeObject(IterT _begin, SentT _end, Probe_node*) : m_begin(_begin), m_end(_end)
+  {}
+
+  IterT begin() const {
+    return m_begin;
+  }
+
+  SentT end() const {
+    return m_end;
+  }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value>::type>
+  std::ptrdiff_t size() const {
+    return _length(m_begin, m_end);
+  }
+};
+
+#endif
+
+
+
+
+
+
+
+// Stores a probe's name. When called on a pair of iterators, returns a ProbeObject which
+// iterates over them, counting and timing.
+// Its purposes are to allow currying and implicit template instantiation.
+struct ProbeOn {
+  const char* name;
+
+  ProbeOn(const char* _name) : name(_name) {}
+
+  template <typename IterT, typename SentT>
+  ProbeObject<IterT, SentT> operator() (IterT start, SentT end) {
+    return ProbeObject<IterT, SentT>(start, end, probes_enabled ? _probe_node(name, false) : nullptr);
+  }
+};
+
+
+
+
+
+
+
+// Probe takes a name and returns a ProbeOn storing it; or a name and a callable, and
+// returns the callable, probed when probes are compiled in. Probes with the same name
+// share their totals.
+inline ProbeOn Probe(const char* name) {
+  return ProbeOn(name);
+}
+
+#ifdef FITER_PROBES
+template <typename F>
+Probed<F> Probe(const char* name, F f) {
+  return Probed<F>(f, _probe_node(name, true));
+}
+#else
+template <typename F>
+F Probe(const char*, F f) {
+  return f;
+}
+#endif
+
+
+
+
+
+
+
+// A probe's totals, and those of the probes upstream of it. For a stage probe, 'items' is
+// the number of items passed on, and 'items_in' the total its stage probe children
+// passed on to it (or -1 if it has none). For a callable's probe, 'items' is the number of
+// calls, and 'passed' the number which returned true (or -1 if it isn't a predicate).
+// Times are per item passed on, or per call: 'ns_per_item' covers everything upstream,
+// and 'own_ns_per_item' only what isn't covered by the children.
+struct ProbeReport {
+  std::string name;
+  bool is_callable;
+  long items;
+  long items_in;
+  long passed;
+  double ns_per_item;
+  double own_ns_per_item;
+  std::vector<ProbeReport> children;
+};
+
+inline double _probe_total_ns(const Probe_node* n) {
+  long sampled = n->sampled.load(std::memory_order_relaxed);
+  long ns = n->ns.load(std::memory_order_relaxed);
+  if(sampled == 0 || ns <= 0) return 0;
+  return (double)ns * n->items.load(std::memory_order_relaxed) / sampled;
+}
+
+inline ProbeReport _probe_report(const Probe_node* n, std::vector<const Probe_node*>& path) {
+  ProbeReport r;
+  r.name = n->name;
+  r.is_callable = n->is_callable;
+  r.items = n->items.load(std::memory_order_relaxed);
+  r.items_in = -1;
+  r.passed = n->is_predicate.load(std::memory_order_relaxed) ? n->passed.load(std::memory_order_relaxed) : -1;
+
+  double total = _probe_total_ns(n), own = total;
+  path.push_back(n);
+  for(const Probe_node* c : n->children) {
+    if(std::find(path.begin(), path.end(), c) != path.end()) continue; // a name reused around a loop
+    r.children.push_back(_probe_report(c, path));
+    own -= _probe_total_ns(c);
+    if(!c->is_callable) r.items_in = (r.items_in < 0 ? 0 : r.items_in) + r.children.back().items;
+  }
+  path.pop_back();
+
+  r.ns_per_item = r.items ? total / r.items : 0;
+  r.own_ns_per_item = r.items ? (own > 0 ? own : 0) / r.items : 0;
+  return r;
+}
+
+// The totals of every probe, as a tree: the roots are the probes no other is upstream of,
+// in the order they were first used. Empty when probes are compiled out.
+inline std::vector<ProbeReport> probe_report() {
+  Probe_registry& reg = _probe_registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::vector<ProbeReport> roots;
+  std::vector<const Probe_node*> path;
+  for(const Probe_node* n : reg.order) {
+    bool is_child = false;
+    for(const Probe_node* p : reg.order)
+      if(std::find(p->children.begin(), p->children.end(), n) != p->children.end()) is_child = true;
+    if(!is_child) roots.push_back(_probe_report(n, path));
+  }
+  return roots;
+}
+
+// Sets every probe's totals back to zero, keeping the tree.
+inline void reset_probes() {
+  Probe_registry& reg = _probe_registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for(Probe_node* n : reg.order) {
+    n->items = 0;
+    n->passed = 0;
+    n->sampled = 0;
+    n->ns = 0;
+  }
+}
+
+inline void _print_probe(std::ostream& out, const ProbeReport& r, int depth) {
+  char line[256];
+  std::string name = std::string(2 * depth, ' ') + r.name;
+  int n = std::snprintf(line, sizeof line, "%-28s %8ld %-6s", name.c_str(), r.items, r.is_callable ? "calls" : "items");
+  if(r.is_callable && r.passed >= 0)
+    n += std::snprintf(line + n, sizeof line - n, " %8ld true (%5.1f%%)  ", r.passed, r.items ? 100.0 * r.passed / r.items : 0.0);
+  else if(r.items_in >= 0)
+    n += std::snprintf(line + n, sizeof line - n, " of %ld in (%5.1f%%)  ", r.items_in, r.items_in ? 100.0 * r.items / r.items_in : 0.0);
+  else
+    n += std::snprintf(line + n, sizeof line - n, "%22s", "");
+  if(r.is_callable)
+    std::snprintf(line + n, sizeof line - n, " %8.2f ns/call", r.ns_per_item);
+  else
+    std::snprintf(line + n, sizeof line - n, " %8.2f ns/item, %.2f own", r.ns_per_item, r.own_ns_per_item);
+  out << line << '\n';
+  for(const ProbeReport& c : r.children)
+    _print_probe(out, c, depth + 1);
+}
+
+// Prints probe_report() as an indented table.
+inline void print_probes(std::ostream& out) {
+  for(const ProbeReport& r : probe_report())
+    _print_probe(out, r, 0);
+}
+
+inline void _print_probe_json(std::ostream& out, const ProbeReport& r) {
+  out << "{\"name\": \"";
+  for(char c : r.name) {
+    if(c == '"' || c == '\\') out << '\\' << c;
+    else if((unsigned char)c < 0x20) out << ' ';
+    else out << c;
+  }
+  char line[256];
+  std::snprintf(line, sizeof line, "\", \"kind\": \"%s\", \"items\": %ld, \"items_in\": %ld, \"passed\": %ld, \"ns_per_item\": %.4f, \"own_ns_per_item\": %.4f, \"children\": [",
+    r.is_callable ? "callable" : "stage", r.items, r.items_in, r.passed, r.ns_per_item, r.own_ns_per_item);
+  out << line;
+  for(std::size_t i = 0; i < r.children.size(); ++i) {
+    if(i) out << ", ";
+    _print_probe_json(out, r.children[i]);
+  }
+  out << "]}";
+}
+
+// Prints probe_report() as a JSON array of trees.
+inline void print_probes_json(std::ostream& out) {
+  out << '[';
+  std::vector<ProbeReport> roots = probe_report();
+  for(std::size_t i = 0; i < roots.size(); ++i) {
+    if(i) out << ", ";
+    _print_probe_json(out, roots[i]);
+  }
+  out << "]\n";
+}
+
+
+
+
+
+}
+
+#endif
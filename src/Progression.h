@@ -4,17 +4,28 @@
 #include <functional>
 #include <iterator>
 #include "FIter.h"
+#include "Simd.h"
 
 namespace FIter {
 
 // An infinite arithmetic progression iterator.
 //
-// WARNING: INFINITE (comparing to .end() always returns false). This can VERY EASILY put
-// infinite loops in your code; do not iterate over this using ranges or .end(). You
-// should ALWAYS use Take or TakeWhile with this, if not outputting a predetermined number
-// of values.
+// WARNING: INFINITE (.end() is an Unreachable, which nothing compares equal to). This can
+// VERY EASILY put infinite loops in your code; do not iterate over this using ranges or
+// .end(). You should ALWAYS use Take or TakeWhile with this, if not outputting a
+// predetermined number of values. Since the compiler knows the end is never reached, those
+// only ever test their own condition.
 //
-// Given a pair of objects A, B of the same type, outputs A, A+B, (A+B)+B, etc.
+// Given a pair of objects A, B of the same type, outputs A, A+B, A+2*B, etc.
+// Iterators are random access, so the nth item can be reached directly, as A+n*B.
+//
+// Each item is worked out from A afresh, as A+n*B, rather than by adding B to the last, so
+// floating point rounding doesn't build up however far one goes (floats are worked out in
+// double). Only types which can't be multiplied by an integer are added up step by step,
+// and their iterators are only bidirectional.
+//
+// Items are worked out a block at a time with SIMD instructions where possible (see
+// Simd.h) when collected in blocks, as by Collect(Take(n)(...)).
 //
 // Create using Progression(), below.
 
@@ -29,58 +40,106 @@ namespace FIter {
 //
 //  This will print '3,13,23,33,43,'.
 
+// Whether the nth item can be worked out directly, as start+n*step.
+template <class ValueT, class = void>
+struct is_indexable : std::false_type {};
+template <class ValueT>
+struct is_indexable<ValueT, decltype(void(ValueT(std::declval<const ValueT&>() + std::declval<const ValueT&>() * std::ptrdiff_t())))> : std::true_type {};
+
+template <class ValueT>
+constexpr ValueT _nth(const ValueT& start, const ValueT& step, std::ptrdiff_t n) {
+  if constexpr (simd::is_fill_type<ValueT>::value) // the same as simd::fill
+    return simd::nth_scalar(start, step, n);
+  else
+    return ValueT(start + step * n);
+}
+
 template<typename ValueT>
 class ProgressionObject {
   ValueT start;
   ValueT step;
 
  public:
-  class const_iterator : public std::iterator<std::forward_iterator_tag, ValueT> {
-   public:
+  // Random access requires that ValueT can be multiplied by a std::ptrdiff_t; otherwise
+  // iterators are only bidirectional. m_cur counts the places moved from the start, and
+  // is what iterators compare; current is the item there, kept so that -> has something
+  // to point to.
+  typedef typename std::conditional<is_indexable<ValueT>::value, std::random_access_iterator_tag, std::bidirectional_iterator_tag>::type iterator_category;
+
+  struct const_iterator : public Iterator_types<iterator_category, ValueT>,
+  public Iterator_base<iterator_category, const_iterator, ValueT>
+  {
     typedef ValueT value_type;
-   private:
-    value_type current;
+
+    value_type start;
     value_type step;
-    bool is_end;
+    value_type current;
+    std::ptrdiff_t m_cur;
     
-   public:
-    const_iterator& operator++() {
-      current += step;
-      return *this;
-    }
-    const_iterator operator++(int) {
-      auto tmp = *this;
-      current += step;
-      return tmp;
-    }
-    value_type operator*() const {
+    constexpr value_type access() const {
       return current;
     }
-    value_type* operator->() const {
+    constexpr const value_type* operator->() const {
       return &current;
     }
-    bool operator==(const const_iterator& r) const {
-      return is_end == r.is_end && current == r.current;
+
+    constexpr void advance() {
+      ++m_cur;
+      if constexpr (is_indexable<value_type>::value) current = _nth(start, step, m_cur);
+      else current += step;
+    }
+    constexpr void unadvance() {
+      --m_cur;
+      if constexpr (is_indexable<value_type>::value) current = _nth(start, step, m_cur);
+      else current -= step;
     }
-    bool operator!=(const const_iterator& r) const {
-      return !(operator==(r));
+    constexpr void advance(std::ptrdiff_t n) {
+      m_cur += n;
+      current = _nth(start, step, m_cur);
+    }
+    constexpr std::ptrdiff_t distance_from(const const_iterator& r) const {
+      return m_cur - r.m_cur;
+    }
+
+    // Internal iteration a block at a time: see _for_each_batch in FIter.h. Blocks are
+    // filled by simd::fill where it handles the type.
+    static std::ptrdiff_t length_to(const const_iterator& b, const const_iterator& e) { return e.m_cur - b.m_cur; }
+    static std::ptrdiff_t length_to(const const_iterator&, Unreachable) { return PTRDIFF_MAX; }
+
+    template <std::size_t N, class S, class Sink, class V = value_type, class = typename std::enable_if<is_indexable<V>::value>::type>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(length_to(b, e), bool()) {
+      value_type items[N];
+      std::ptrdiff_t n = b.m_cur;
+      for(std::ptrdiff_t left = length_to(b, e); left > 0; left -= N, n += N) {
+        std::size_t count = std::min<std::ptrdiff_t>(left, N);
+        {
+          FITER_TRACE("Progression");
+          if constexpr (simd::is_fill_type<value_type>::value)
+            simd::fill(items, count, b.start, b.step, n);
+          else
+            for(std::size_t i = 0; i < count; ++i)
+              items[i] = _nth(b.start, b.step, n + i);
+        }
+        if(!sink(items, count)) return false;
+      }
+      return true;
     }
     
-    const_iterator(value_type _current, value_type _step, bool _is_end) :
-     current(_current), step(_step), is_end(_is_end)
+    constexpr const_iterator(value_type _start, value_type _step) :
+     start(_start), step(_step), current(_start), m_cur(0)
     {}
   };
   
-  ProgressionObject(ValueT _start, ValueT _step) :
+  constexpr ProgressionObject(ValueT _start, ValueT _step) :
    start(_start), step(_step)
   {}
   
-  const_iterator begin() {
-    return const_iterator(start, step, false);
+  constexpr const_iterator begin() const {
+    return const_iterator(start, step);
   }
   
-  const_iterator end() {
-    return const_iterator(start, step, true);
+  constexpr Unreachable end() const {
+    return Unreachable();
   }
 };
 
@@ -90,21 +149,21 @@ class ProgressionObject {
 
 
 // Create a ProgressionObject counting longs from 0 by 1: 0,1,2,...
-ProgressionObject<long> Progression() {
+constexpr ProgressionObject<long> Progression() {
   return ProgressionObject<long>(0, 1);
 }
 
 // Create a ProgressionObject counting from start by 1s: start, (start+1),...
 // Requires that start has +(int) defined. 
 template<typename value_type>
-ProgressionObject<value_type> Progression(value_type start) {
+constexpr ProgressionObject<value_type> Progression(value_type start) {
   return ProgressionObject<value_type>(start, 1);
 }
 
 // Create a ProgressionObject counting from start by steps: start, (start+step),...
 // Requires that start has +(typeof(start)) defined.
 template<typename value_type>
-ProgressionObject<value_type> Progression(value_type start, value_type step) {
+constexpr ProgressionObject<value_type> Progression(value_type start, value_type step) {
   return ProgressionObject<value_type>(start, step);
 }
 
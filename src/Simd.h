@@ -0,0 +1,482 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+#include "Compare.h"
+
+// SIMD versions are built for x86 with GCC or Clang, each function marked for the
+// instructions it uses, so nothing more than the baseline needs to be enabled at compile
+// time; the best the CPU supports is picked when first used. Define FITER_NO_SIMD to leave
+// only the scalar versions.
+#if !defined(FITER_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FITER_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define FITER_SIMD_X86 0
+#endif
+
+namespace FIter {
+
+
+// Whether iterators of type IterT point into an array: pointers, vector iterators, and
+// iterators of our own which say so with a member 'typedef void contiguous' (such as
+// MmapRange's). (Other containers' iterators are never treated as contiguous.)
+template <class IterT, class = void>
+struct declares_contiguous : std::false_type {};
+
+template <class IterT>
+struct declares_contiguous<IterT, typename IterT::contiguous> : std::true_type {};
+
+template <class IterT, class = void>
+struct is_contiguous : std::is_pointer<IterT> {};
+
+template <class IterT>
+struct is_contiguous<IterT, typename std::enable_if<!std::is_pointer<IterT>::value && !std::is_same<typename std::iterator_traits<IterT>::value_type, bool>::value>::type> :
+  std::integral_constant<bool,
+    std::is_same<IterT, typename std::vector<typename std::iterator_traits<IterT>::value_type>::iterator>::value ||
+    std::is_same<IterT, typename std::vector<typename std::iterator_traits<IterT>::value_type>::const_iterator>::value ||
+    declares_contiguous<IterT>::value> {};
+
+
+namespace simd {
+
+
+// Stream compaction and search for comparison predicates (see Compare.h) over arrays of
+// 32 bit ints, floats and doubles.
+//
+// compact(in, n, pred, out) copies the items of in[0, n) for which pred is true to out, in
+// order, and returns how many there were. out must have room for n items, all of which
+// may be written to. find(in, n, pred) returns the index of the first item for which pred
+// is true, or n.
+//
+// Each has a scalar, an SSE4.1 and an AVX2 version, which give exactly the same results
+// (floating point comparisons treat NaNs as the scalar operators do), and the plain names
+// call the best one the CPU supports. The versions can also be called directly, for
+// testing; the SIMD ones must only be called when supported().
+
+template <class T>
+struct is_simd_type : std::integral_constant<bool, std::is_same<T, std::int32_t>::value || std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+enum Level { scalar = 0, sse4 = 1, avx2 = 2 };
+
+inline Level detect() {
+#if FITER_SIMD_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return avx2;
+  if(__builtin_cpu_supports("sse4.1")) return sse4;
+#endif
+  return scalar;
+}
+
+inline Level level() {
+  static const Level l = detect();
+  return l;
+}
+
+inline bool supported(Level l) {
+  return l <= level();
+}
+
+// Whether this is being worked out at compile time, in a constant expression, where only
+// the scalar versions can run. Always false with compilers which can't tell, which then
+// can't use find() in constant expressions.
+constexpr bool constant_evaluated() {
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+  return __builtin_is_constant_evaluated();
+#endif
+#endif
+  return false;
+}
+
+
+template <Cmp op, class T>
+std::size_t compact_scalar(const T* in, std::size_t n, const Compare<op, T>& pred, T* out) {
+  std::size_t kept = 0;
+  for(std::size_t i = 0; i < n; ++i) { // without branching: every item is written, and kept if it passes
+    out[kept] = in[i];
+    kept += pred(in[i]);
+  }
+  return kept;
+}
+
+template <Cmp op, class T>
+constexpr std::size_t find_scalar(const T* in, std::size_t n, const Compare<op, T>& pred) {
+  std::size_t i = 0;
+  while(i < n && !pred(in[i])) ++i;
+  return i;
+}
+
+
+#if FITER_SIMD_X86
+
+// Shuffles for compaction: for each mask of L lanes, the indices of the set lanes, in
+// order, followed by anything, and how many there are (rather than needing POPCNT). Lane
+// indices are given in units of U bytes, each lane being W bytes wide, so that the same
+// table shape serves both byte shuffles (U = 1) and 32 bit permutes (U = 4).
+template <class IndexT, unsigned L, unsigned W, unsigned U>
+struct Shuffles {
+  alignas(32) IndexT index[1 << L][L * W / U];
+  std::uint8_t count[1 << L];
+
+  Shuffles() {
+    for(unsigned mask = 0; mask < (1u << L); ++mask) {
+      count[mask] = 0;
+      for(unsigned lane = 0; lane < L; ++lane)
+        count[mask] += (mask >> lane) & 1;
+      unsigned out = 0;
+      for(unsigned lane = 0; lane < L; ++lane)
+        if(mask & (1u << lane))
+          for(unsigned part = 0; part < W / U; ++part)
+            index[mask][out++] = (IndexT)(lane * W / U + part);
+      while(out < L * W / U) index[mask][out++] = 0;
+    }
+  }
+};
+
+template <class IndexT, unsigned L, unsigned W, unsigned U>
+const Shuffles<IndexT, L, W, U>& shuffles() {
+  static const Shuffles<IndexT, L, W, U> s;
+  return s;
+}
+
+// Lane masks: bit i is set if pred holds of lane i. Integer comparisons only come as > and
+// ==, so the rest are made by swapping or negating those.
+template <Cmp op>
+__attribute__((target("avx2"))) inline unsigned mask_avx2(__m256i x, __m256i v) {
+  __m256i m;
+  if(op == Cmp::gt || op == Cmp::le) m = _mm256_cmpgt_epi32(x, v);
+  else if(op == Cmp::lt || op == Cmp::ge) m = _mm256_cmpgt_epi32(v, x);
+  else m = _mm256_cmpeq_epi32(x, v);
+  unsigned bits = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+  return (op == Cmp::le || op == Cmp::ge || op == Cmp::ne) ? ~bits & 0xff : bits;
+}
+
+template <Cmp op>
+__attribute__((target("avx2"))) inline unsigned mask_avx2(__m256 x, __m256 v) {
+  switch(op) {
+    case Cmp::lt: return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_LT_OQ));
+    case Cmp::le: return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_LE_OQ));
+    case Cmp::gt: return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_GT_OQ));
+    case Cmp::ge: return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_GE_OQ));
+    case Cmp::eq: return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_EQ_OQ));
+    case Cmp::ne: return (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_NEQ_UQ));
+  }
+  return 0;
+}
+
+template <Cmp op>
+__attribute__((target("avx2"))) inline unsigned mask_avx2(__m256d x, __m256d v) {
+  switch(op) {
+    case Cmp::lt: return (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_LT_OQ));
+    case Cmp::le: return (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_LE_OQ));
+    case Cmp::gt: return (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_GT_OQ));
+    case Cmp::ge: return (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_GE_OQ));
+    case Cmp::eq: return (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_EQ_OQ));
+    case Cmp::ne: return (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(x, v, _CMP_NEQ_UQ));
+  }
+  return 0;
+}
+
+template <Cmp op>
+__attribute__((target("sse4.1"))) inline unsigned mask_sse4(__m128i x, __m128i v) {
+  __m128i m;
+  if(op == Cmp::gt || op == Cmp::le) m = _mm_cmpgt_epi32(x, v);
+  else if(op == Cmp::lt || op == Cmp::ge) m = _mm_cmpgt_epi32(v, x);
+  else m = _mm_cmpeq_epi32(x, v);
+  unsigned bits = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m));
+  return (op == Cmp::le || op == Cmp::ge || op == Cmp::ne) ? ~bits & 0xf : bits;
+}
+
+template <Cmp op>
+__attribute__((target("sse4.1"))) inline unsigned mask_sse4(__m128 x, __m128 v) {
+  switch(op) {
+    case Cmp::lt: return (unsigned)_mm_movemask_ps(_mm_cmplt_ps(x, v));
+    case Cmp::le: return (unsigned)_mm_movemask_ps(_mm_cmple_ps(x, v));
+    case Cmp::gt: return (unsigned)_mm_movemask_ps(_mm_cmpgt_ps(x, v));
+    case Cmp::ge: return (unsigned)_mm_movemask_ps(_mm_cmpge_ps(x, v));
+    case Cmp::eq: return (unsigned)_mm_movemask_ps(_mm_cmpeq_ps(x, v));
+    case Cmp::ne: return (unsigned)_mm_movemask_ps(_mm_cmpneq_ps(x, v));
+  }
+  return 0;
+}
+
+template <Cmp op>
+__attribute__((target("sse4.1"))) inline unsigned mask_sse4(__m128d x, __m128d v) {
+  switch(op) {
+    case Cmp::lt: return (unsigned)_mm_movemask_pd(_mm_cmplt_pd(x, v));
+    case Cmp::le: return (unsigned)_mm_movemask_pd(_mm_cmple_pd(x, v));
+    case Cmp::gt: return (unsigned)_mm_movemask_pd(_mm_cmpgt_pd(x, v));
+    case Cmp::ge: return (unsigned)_mm_movemask_pd(_mm_cmpge_pd(x, v));
+    case Cmp::eq: return (unsigned)_mm_movemask_pd(_mm_cmpeq_pd(x, v));
+    case Cmp::ne: return (unsigned)_mm_movemask_pd(_mm_cmpneq_pd(x, v));
+  }
+  return 0;
+}
+
+// Loads and broadcasts, by item type. Everything is moved about as 32 bit lanes (AVX2) or
+// bytes (SSE4.1) once compared, so only the comparisons need the real type.
+__attribute__((target("avx2"))) inline __m256i load_avx2(const std::int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+__attribute__((target("avx2"))) inline __m256 load_avx2(const float* p) { return _mm256_loadu_ps(p); }
+__attribute__((target("avx2"))) inline __m256d load_avx2(const double* p) { return _mm256_loadu_pd(p); }
+__attribute__((target("avx2"))) inline __m256i splat_avx2(std::int32_t v) { return _mm256_set1_epi32(v); }
+__attribute__((target("avx2"))) inline __m256 splat_avx2(float v) { return _mm256_set1_ps(v); }
+__attribute__((target("avx2"))) inline __m256d splat_avx2(double v) { return _mm256_set1_pd(v); }
+
+__attribute__((target("sse4.1"))) inline __m128i load_sse4(const std::int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+__attribute__((target("sse4.1"))) inline __m128 load_sse4(const float* p) { return _mm_loadu_ps(p); }
+__attribute__((target("sse4.1"))) inline __m128d load_sse4(const double* p) { return _mm_loadu_pd(p); }
+__attribute__((target("sse4.1"))) inline __m128i splat_sse4(std::int32_t v) { return _mm_set1_epi32(v); }
+__attribute__((target("sse4.1"))) inline __m128 splat_sse4(float v) { return _mm_set1_ps(v); }
+__attribute__((target("sse4.1"))) inline __m128d splat_sse4(double v) { return _mm_set1_pd(v); }
+
+template <Cmp op, class T>
+__attribute__((target("avx2"))) std::size_t compact_avx2(const T* in, std::size_t n, const Compare<op, T>& pred, T* out) {
+  const unsigned L = 32 / sizeof(T);
+  const auto& table = shuffles<std::uint32_t, L, sizeof(T), 4>();
+  auto v = splat_avx2(pred.value);
+  std::size_t i = 0, kept = 0;
+  for(; i + L <= n; i += L) {
+    unsigned mask = mask_avx2<op>(load_avx2(in + i), v);
+    __m256i lanes = _mm256_loadu_si256((const __m256i*)(in + i));
+    __m256i order = _mm256_load_si256((const __m256i*)table.index[mask]);
+    _mm256_storeu_si256((__m256i*)(out + kept), _mm256_permutevar8x32_epi32(lanes, order));
+    kept += table.count[mask];
+  }
+  return kept + compact_scalar(in + i, n - i, pred, out + kept);
+}
+
+template <Cmp op, class T>
+__attribute__((target("avx2"))) std::size_t find_avx2(const T* in, std::size_t n, const Compare<op, T>& pred) {
+  const unsigned L = 32 / sizeof(T);
+  auto v = splat_avx2(pred.value);
+  std::size_t i = 0;
+  for(; i + L <= n; i += L)
+    if(unsigned mask = mask_avx2<op>(load_avx2(in + i), v))
+      return i + __builtin_ctz(mask);
+  return i + find_scalar(in + i, n - i, pred);
+}
+
+template <Cmp op, class T>
+__attribute__((target("sse4.1"))) std::size_t compact_sse4(const T* in, std::size_t n, const Compare<op, T>& pred, T* out) {
+  const unsigned L = 16 / sizeof(T);
+  const auto& table = shuffles<std::uint8_t, L, sizeof(T), 1>();
+  auto v = splat_sse4(pred.value);
+  std::size_t i = 0, kept = 0;
+  for(; i + L <= n; i += L) {
+    unsigned mask = mask_sse4<op>(load_sse4(in + i), v);
+    __m128i lanes = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i order = _mm_load_si128((const __m128i*)table.index[mask]);
+    _mm_storeu_si128((__m128i*)(out + kept), _mm_shuffle_epi8(lanes, order));
+    kept += table.count[mask];
+  }
+  return kept + compact_scalar(in + i, n - i, pred, out + kept);
+}
+
+template <Cmp op, class T>
+__attribute__((target("sse4.1"))) std::size_t find_sse4(const T* in, std::size_t n, const Compare<op, T>& pred) {
+  const unsigned L = 16 / sizeof(T);
+  auto v = splat_sse4(pred.value);
+  std::size_t i = 0;
+  for(; i + L <= n; i += L)
+    if(unsigned mask = mask_sse4<op>(load_sse4(in + i), v))
+      return i + __builtin_ctz(mask);
+  return i + find_scalar(in + i, n - i, pred);
+}
+
+#endif
+
+
+template <Cmp op, class T>
+std::size_t compact(const T* in, std::size_t n, const Compare<op, T>& pred, T* out) {
+#if FITER_SIMD_X86
+  switch(level()) {
+    case avx2: return compact_avx2(in, n, pred, out);
+    case sse4: return compact_sse4(in, n, pred, out);
+    case scalar: break;
+  }
+#endif
+  return compact_scalar(in, n, pred, out);
+}
+
+template <Cmp op, class T>
+constexpr std::size_t find(const T* in, std::size_t n, const Compare<op, T>& pred) {
+#if FITER_SIMD_X86
+  if(!constant_evaluated()) switch(level()) {
+    case avx2: return find_avx2(in, n, pred);
+    case sse4: return find_sse4(in, n, pred);
+    case scalar: break;
+  }
+#endif
+  return find_scalar(in, n, pred);
+}
+
+
+// Compaction by flags, for predicates other than comparisons: compact_flagged(in, n,
+// flags, out) copies the items of in[0, n) whose flag (0 or 1) is set to out, in order,
+// and returns how many there were; out must have room for n items, all of which may be
+// written to, and may be in itself (so compacting in place). The flags are worked out first, in a loop of their own which the compiler
+// can often vectorise; the items are then moved as they are, so any trivially copyable
+// type of 4 or 8 bytes will do. A scalar, an SSE4.1 and an AVX2 version, which give exactly
+// the same results, and the plain name calls the best one the CPU supports.
+
+template <class T>
+struct is_flagged_type : std::integral_constant<bool, std::is_trivially_copyable<T>::value && (sizeof(T) == 4 || sizeof(T) == 8)> {};
+
+template <class T>
+std::size_t compact_flagged_scalar(const T* in, std::size_t n, const std::uint32_t* flags, T* out) {
+  std::size_t kept = 0;
+  for(std::size_t i = 0; i < n; ++i) {
+    out[kept] = in[i];
+    kept += flags[i];
+  }
+  return kept;
+}
+
+#if FITER_SIMD_X86
+
+// Flags are 0 or 1, so negated they have their sign bits set where they're set.
+template <class T>
+__attribute__((target("avx2"))) std::size_t compact_flagged_avx2(const T* in, std::size_t n, const std::uint32_t* flags, T* out) {
+  const unsigned L = 32 / sizeof(T);
+  const auto& table = shuffles<std::uint32_t, L, sizeof(T), 4>();
+  std::size_t i = 0, kept = 0;
+  for(; i + L <= n; i += L) {
+    unsigned mask;
+    if constexpr (L == 8)
+      mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_sub_epi32(_mm256_setzero_si256(), _mm256_loadu_si256((const __m256i*)(flags + i)))));
+    else
+      mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_sub_epi32(_mm_setzero_si128(), _mm_loadu_si128((const __m128i*)(flags + i)))));
+    __m256i lanes = _mm256_loadu_si256((const __m256i*)(in + i));
+    __m256i order = _mm256_load_si256((const __m256i*)table.index[mask]);
+    _mm256_storeu_si256((__m256i*)(out + kept), _mm256_permutevar8x32_epi32(lanes, order));
+    kept += table.count[mask];
+  }
+  return kept + compact_flagged_scalar(in + i, n - i, flags + i, out + kept);
+}
+
+template <class T>
+__attribute__((target("sse4.1"))) std::size_t compact_flagged_sse4(const T* in, std::size_t n, const std::uint32_t* flags, T* out) {
+  const unsigned L = 16 / sizeof(T);
+  const auto& table = shuffles<std::uint8_t, L, sizeof(T), 1>();
+  std::size_t i = 0, kept = 0;
+  for(; i + L <= n; i += L) {
+    __m128i f;
+    if constexpr (L == 4)
+      f = _mm_loadu_si128((const __m128i*)(flags + i));
+    else
+      f = _mm_loadl_epi64((const __m128i*)(flags + i));
+    unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_sub_epi32(_mm_setzero_si128(), f))) & ((1u << L) - 1);
+    __m128i lanes = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i order = _mm_load_si128((const __m128i*)table.index[mask]);
+    _mm_storeu_si128((__m128i*)(out + kept), _mm_shuffle_epi8(lanes, order));
+    kept += table.count[mask];
+  }
+  return kept + compact_flagged_scalar(in + i, n - i, flags + i, out + kept);
+}
+
+#endif
+
+template <class T>
+std::size_t compact_flagged(const T* in, std::size_t n, const std::uint32_t* flags, T* out) {
+#if FITER_SIMD_X86
+  switch(level()) {
+    case avx2: return compact_flagged_avx2(in, n, flags, out);
+    case sse4: return compact_flagged_sse4(in, n, flags, out);
+    case scalar: break;
+  }
+#endif
+  return compact_flagged_scalar(in, n, flags, out);
+}
+
+
+// Filling an array with an arithmetic progression: fill(out, n, start, step, first) sets
+// out[i] to item first+i of the progression start, start+step, ..., each worked out as
+// start+(first+i)*step, as Progression does (floats are worked out in double). Covers 32
+// and 64 bit ints, floats and doubles, with a scalar and an AVX2 version, which give
+// exactly the same results.
+
+template <class T>
+struct is_fill_type : std::integral_constant<bool, std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value || std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+template <class T>
+constexpr T nth_scalar(T start, T step, std::ptrdiff_t n) {
+  if constexpr (std::is_same<T, float>::value)
+    return float(double(start) + double(step) * double(n));
+  else if constexpr (std::is_same<T, double>::value)
+    return start + step * double(n);
+  else // wraps around as the items themselves would
+    return T((typename std::make_unsigned<T>::type)start + (typename std::make_unsigned<T>::type)step * (std::uint64_t)n);
+}
+
+template <class T>
+void fill_scalar(T* out, std::size_t n, T start, T step, std::ptrdiff_t first) {
+  for(std::size_t i = 0; i < n; ++i)
+    out[i] = nth_scalar(start, step, first + (std::ptrdiff_t)i);
+}
+
+#if FITER_SIMD_X86
+
+// Integers are exact, so lanes just add on a multiple of step each time round. Floating
+// point lanes keep their indices as doubles (exact up to 2^53) and multiply out.
+template <class T>
+__attribute__((target("avx2"))) void fill_avx2(T* out, std::size_t n, T start, T step, std::ptrdiff_t first) {
+  std::size_t i = 0;
+  if constexpr (std::is_same<T, std::int32_t>::value || std::is_same<T, std::int64_t>::value) {
+    const unsigned L = 32 / sizeof(T);
+    alignas(32) T lanes[L];
+    fill_scalar(lanes, L, start, step, first);
+    __m256i v = _mm256_load_si256((const __m256i*)lanes);
+    __m256i stride = sizeof(T) == 4 ? _mm256_set1_epi32((std::int32_t)nth_scalar<T>(0, step, L)) : _mm256_set1_epi64x((long long)nth_scalar<T>(0, step, L));
+    for(; i + L <= n; i += L) {
+      _mm256_storeu_si256((__m256i*)(out + i), v);
+      v = sizeof(T) == 4 ? _mm256_add_epi32(v, stride) : _mm256_add_epi64(v, stride);
+    }
+  }
+  else {
+    __m256d vstart = _mm256_set1_pd(double(start)), vstep = _mm256_set1_pd(double(step)), four = _mm256_set1_pd(4.0);
+    __m256d index = _mm256_setr_pd(double(first), double(first + 1), double(first + 2), double(first + 3));
+    for(; i + 4 <= n; i += 4) {
+      __m256d x = _mm256_add_pd(vstart, _mm256_mul_pd(vstep, index));
+      if constexpr (std::is_same<T, float>::value)
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(x));
+      else
+        _mm256_storeu_pd(out + i, x);
+      index = _mm256_add_pd(index, four);
+    }
+  }
+  fill_scalar(out + i, n - i, start, step, first + (std::ptrdiff_t)i);
+}
+
+#endif
+
+template <class T>
+void fill(T* out, std::size_t n, T start, T step, std::ptrdiff_t first) {
+#if FITER_SIMD_X86
+  if(level() == avx2) return fill_avx2(out, n, start, step, first);
+#endif
+  fill_scalar(out, n, start, step, first);
+}
+
+
+// Whether a Filter over iterators of type IterT, ending at SentT, with a predicate of type
+// func, can use the above: the items must be in an array of a supported type, the end must
+// be an iterator into it, and the predicate must compare against the same type.
+template <class IterT, class SentT, class func>
+struct can_compact : std::false_type {};
+
+template <class IterT, Cmp op, class T>
+struct can_compact<IterT, IterT, Compare<op, T>> : std::integral_constant<bool,
+  is_contiguous<IterT>::value && is_simd_type<T>::value &&
+  std::is_same<typename std::iterator_traits<IterT>::value_type, T>::value> {};
+
+
+}
+
+}
+
+#endif
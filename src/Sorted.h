@@ -0,0 +1,84 @@
+#ifndef SORTED_H
+#define SORTED_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include "FIter.h"
+
+namespace FIter {
+
+
+// Predicates known to be monotone.
+//
+// The point of this file. Sorted(f) is a callable object which behaves exactly like f, but
+// whose type promises that f is true of some first items of the sequence it is used on and
+// false of all the rest: as 'x < k' is of a sequence sorted in ascending order. TakeWhile
+// and DropWhile recognise it (as Filter does the comparisons of Compare.h), and over
+// random access iterators ending in iterators, or not ending, find where f turns false by
+// galloping and then binary search: O(log k) calls of f, k being the number of items which
+// pass, rather than k+1. They then return a Take or a Drop of exactly that many items, so
+// that iterating over the result never calls f at all.
+//
+// Over other iterators, Sorted(f) is just f, and the stages work as usual.
+//
+// If f isn't in fact monotone over the sequence, which items are taken or dropped is
+// unspecified (though it is always some first items).
+//
+
+// Usage example:
+//
+// std::vector<long> ts{1, 3, 4, 8, 10, 11, 15}; // sorted
+// auto span = ts | FIter::DropWhile(FIter::Sorted([](long t){return t < 4;}))
+//                | FIter::TakeWhile(FIter::Sorted([](long t){return t < 11;}));
+// for(auto t : span)
+//   std::cout << t << ",";
+//
+// This will print '4,8,10,', having called each predicate only a few times.
+
+template <typename F>
+struct Monotone {
+  F f;
+
+  template <typename T>
+  constexpr bool operator()(const T& x) const { return f(x); }
+};
+
+template <typename F>
+constexpr Monotone<F> Sorted(F f) {
+  return Monotone<F>{f};
+}
+
+template <class F>
+struct is_monotone : std::false_type {};
+template <class F>
+struct is_monotone<Monotone<F>> : std::true_type {};
+
+
+
+
+
+
+
+// The first item from first for which pred is false (or the end), for a pred which is
+// true of some first items and false of the rest, and a random access iterator ending in
+// an iterator or an Unreachable (see is_jumpable in FIter.h). Steps of 1, 2, 4, ... are
+// taken while pred holds at the end of each, and the last step is then searched by
+// halves, so pred is called O(log k) times if the answer is k items on.
+template <class IterT, class SentT, class Pred>
+IterT _partition_point(IterT first, const SentT& end, const Pred& pred) {
+  std::ptrdiff_t left = _length(first, end);
+  std::ptrdiff_t step = std::min<std::ptrdiff_t>(1, left);
+  while(step < left && pred(first[step - 1])) { // everything before first passes
+    first += step;
+    left -= step;
+    step = step <= left / 2 ? step * 2 : left;
+  }
+  return std::partition_point(first, first + step, pred);
+}
+
+
+
+}
+
+#endif
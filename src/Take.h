@@ -18,6 +18,20 @@ namespace FIter {
 // If you ask for more items than you supply, this will only iterate over items supplied.
 // (E.g., taking ten items from a two-item list results in two items.)
 //
+// If the original iterators are random access, so are these. When the end is then also
+// an iterator, or there is no end (as for a Progression), end() is an iterator too, found
+// in constant time.
+//
+// Otherwise, when the pair ends in an iterator, end() is an iterator which has taken
+// enough already, and iterators which have taken enough or run out compare equal to it,
+// so that standard algorithms and containers' range constructors work. The end of the pair
+// may also be a sentinel of type SentT (such as a Progression's Unreachable, in which case
+// only the count is ever checked), and end() is then an empty sentinel: iterators count
+// down to it themselves.
+//
+// If the original pair is sized (see FIter.h) or endless, this one is sized, and size() is
+// defined.
+//
 // Create using Take(), below.
 //
 
@@ -30,27 +44,30 @@ namespace FIter {
 // 
 // This will print '0,1,2'.
 
-template<typename IterT>
+template<typename IterT, typename SentT = IterT>
 class TakeObject {
 
-  typedef typename IterT::value_type value_type;
-  // Note: The following is necessary because TakeObjects never support reverse iteration.
-  typedef typename least_iterator_type<typename IterT::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+  typedef typename std::iterator_traits<IterT>::value_type value_type;
+  // Note: The following is necessary because TakeObjects only support reverse iteration
+  // as part of random access.
+  typedef typename random_or_forward<typename std::iterator_traits<IterT>::iterator_category>::type least_common_subtype;
 
  protected:
   const IterT m_begin;
-  const IterT m_end;
+  const SentT m_end;
  
   const long to_take;
 
 
  public:
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
   public Iterator_base<least_common_subtype, const_iterator, value_type>
   {
     IterT m_cur;
+    SentT m_end;
     long to_take;
-    bool is_end;
 
     // Get the iterator at the base of a chain of FIters. For example, if you apply a
     // filter to a vector, and then a map to the filter, calling this on the map will
@@ -60,47 +77,139 @@ class TakeObject {
       return _get_base<IterT>(m_cur, 0);
     }
    
-    value_type access() const { return *m_cur; }
+    constexpr value_type access() const { return *m_cur; }
 
-    void advance() {
+    constexpr void advance() {
 			--to_take;
 			++m_cur;
     }
+
+    constexpr void unadvance() {
+			++to_take;
+			--m_cur;
+    }
+
+    constexpr void advance(std::ptrdiff_t n) {
+			to_take -= n;
+			m_cur += n;
+    }
+
+    constexpr std::ptrdiff_t distance_from(const const_iterator& r) const {
+      return m_cur - r.m_cur;
+    }
     
-    // Take handles comparisons differently, to support ending in the right place.
-    bool operator==(const const_iterator& r) const {
-      if(to_take == 0 && r.is_end) { // taken enough, stop.
-        return true;
+    // Taken enough, or run out of items to take.
+    constexpr bool reached(const sentinel&) const {
+      return to_take <= 0 || m_cur == m_end;
+    }
+
+    // Where the end can't be found up front, end() is just finished, not in the same place
+    // as an iterator which finishes; all finished iterators are equal.
+    constexpr bool operator==(const const_iterator& r) const {
+      if constexpr (is_jumpable<IterT, SentT>::value)
+        return m_cur == r.m_cur;
+      else if(reached(sentinel()) || r.reached(sentinel()))
+        return reached(sentinel()) == r.reached(sentinel());
+      else
+        return m_cur == r.m_cur;
+    }
+
+    template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value || std::is_same<S, Unreachable>::value>::type>
+    constexpr std::ptrdiff_t remaining(const sentinel&) const {
+      return std::max<std::ptrdiff_t>(std::min<std::ptrdiff_t>(to_take, _length(m_cur, m_end)), 0);
+    }
+
+    // Internal iteration: see _for_each in FIter.h. Where the last item can be found up
+    // front, the original items are pushed up to it with no count at all; otherwise the
+    // count is kept in the sink.
+    template <class Sink>
+    static bool push(const const_iterator& b, const const_iterator& e, Sink& sink) {
+      if(!is_jumpable<IterT, SentT>::value && e.reached(sentinel()))
+        return push(b, sentinel(), sink);
+      return _for_each(b.m_cur, e.m_cur, sink);
+    }
+
+    template <class Sink>
+    static bool push(const const_iterator& b, const sentinel&, Sink& sink) {
+      if constexpr (is_jumpable<IterT, SentT>::value) {
+        return _for_each(b.m_cur, _advance_within(b.m_cur, b.m_end, b.to_take), sink);
       }
-      else if(is_end && r.is_end) { // two end iterators are always identical
-        return true;
+      else {
+        long left = b.to_take;
+        if(left <= 0) return true;
+        bool more = true;
+        _for_each(b.m_cur, b.m_end, [&](auto&& x) {
+          more = sink(std::forward<decltype(x)>(x));
+          return more && --left > 0;
+        });
+        return more;
+      }
+    }
+
+    // The same, a block at a time: the last block is cut short.
+    template <std::size_t N, class Sink>
+    static bool push_batch(const const_iterator& b, const const_iterator& e, Sink& sink) {
+      if(!is_jumpable<IterT, SentT>::value && e.reached(sentinel()))
+        return push_batch<N>(b, sentinel(), sink);
+      return _for_each_batch<N>(b.m_cur, e.m_cur, sink);
+    }
+
+    template <std::size_t N, class Sink>
+    static bool push_batch(const const_iterator& b, const sentinel&, Sink& sink) {
+      if constexpr (is_jumpable<IterT, SentT>::value) {
+        return _for_each_batch<N>(b.m_cur, _advance_within(b.m_cur, b.m_end, b.to_take), sink);
       }
       else {
-        return m_cur == r.m_cur;
+        long left = b.to_take;
+        if(left <= 0) return true;
+        bool more = true;
+        _for_each_batch<N>(b.m_cur, b.m_end, [&](auto* items, std::size_t n) {
+          if((long)n >= left) {
+            more = sink(items, (std::size_t)left);
+            return false;
+          }
+          left -= n;
+          return more = sink(items, n);
+        });
+        return more;
       }
     }
 
-    const_iterator(const IterT & _cur, long _to_take, bool _is_end) : m_cur(_cur), to_take(_to_take), is_end(_is_end)
+    constexpr const_iterator(const IterT & _cur, const SentT & _end, long _to_take) : m_cur(_cur), m_end(_end), to_take(_to_take)
     {} 
 
-    const_iterator(const const_iterator& r) :  m_cur(r.m_cur),  to_take(r.to_take), is_end(r.is_end)
+    constexpr const_iterator(const const_iterator& r) :  m_cur(r.m_cur), m_end(r.m_end), to_take(r.to_take)
     {}
     
-    const_iterator& operator=(const const_iterator& r)
-    { m_cur = r.m_cur; to_take = r.to_take; is_end = r.is_end; return *this; }
+    constexpr const_iterator& operator=(const const_iterator& r)
+    { m_cur = r.m_cur; m_end = r.m_end; to_take = r.to_take; return *this; }
   };
   
 
-  TakeObject(IterT _begin, IterT _end, long _to_take) : m_begin(_begin), m_end(_end), to_take(_to_take)
+  constexpr TakeObject(IterT _begin, SentT _end, long _to_take) : m_begin(_begin), m_end(_end), to_take(_to_take)
   {}
    
-  const_iterator begin() const {
-    return const_iterator(m_begin, to_take, false);
+  constexpr const_iterator begin() const {
+    return const_iterator(m_begin, m_end, to_take);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end, 0, true);
+  constexpr auto end() const { // See FIter.h for _advance_within.
+    if constexpr (is_jumpable<IterT, SentT>::value) {
+      IterT last = _advance_within(m_begin, m_end, to_take);
+      return const_iterator(last, m_end, to_take - (last - m_begin));
+    }
+    else if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, m_end, 0);
+    else
+      return sentinel();
   }
+
+  template <class S = SentT, class = typename std::enable_if<is_sized<IterT, S>::value || std::is_same<S, Unreachable>::value>::type>
+  constexpr std::ptrdiff_t size() const { // See FIter.h for _length.
+    return std::max<std::ptrdiff_t>(std::min<std::ptrdiff_t>(to_take, _length(m_begin, m_end)), 0);
+  }
+
+  friend struct Fusion; // see Pipe.h
 };
 
 
@@ -115,11 +224,11 @@ class Take {
   public:
   long n;
   
-  Take(long _n) : n(_n) {}
+  constexpr Take(long _n) : n(_n) {}
   
-  template <typename IterT>
-  TakeObject<IterT> operator() (IterT start, IterT end) {
-    return TakeObject<IterT>(start, end, n);
+  template <typename IterT, typename SentT>
+  constexpr TakeObject<IterT, SentT> operator() (IterT start, SentT end) {
+    return TakeObject<IterT, SentT>(start, end, n);
   }
 };
 
@@ -1,9 +1,11 @@
 #ifndef TAKEWHILE_H
 #define TAKEWHILE_H
 
-#include <functional>
 #include <iterator>
+#include <type_traits>
 #include "FIter.h"
+#include "Sorted.h"
+#include "Take.h"
 
 namespace FIter {
 
@@ -12,11 +14,24 @@ namespace FIter {
 //
 // The point of this file. Given a pair of iterators of type IterT and a boolean function,
 // it can create forward iterators (a nested subtype) from the passed pair. However, these
-// created iterators end once the function returns false for one of them.
+// created iterators end once the function returns false for one of them. The function is
+// called once per item, as the iterator reaches it.
 //
 // If you ask for more items than you supply, this will only iterate over items supplied.
 // (E.g., taking ten items from a two-item list results in two items.)
 //
+// Iterators know when they have finished, so comparing with the end is just a test of a
+// flag. When the pair ends in an iterator, end() is an iterator too, already finished, so
+// that standard algorithms and containers' range constructors work; all finished iterators
+// are equal. The end of the pair may be a sentinel of type SentT instead, and end() is then
+// an empty sentinel.
+//
+// With a predicate wrapped in Sorted() (see Sorted.h), over random access iterators ending
+// in iterators or not ending, TakeWhile() finds the first item to fail by binary search
+// up front, and returns a TakeObject of the items before it instead.
+//
+// As for Map and Filter, the function must be callable as const.
+//
 // Create using TakeWhile(), below.
 //
 
@@ -29,27 +44,33 @@ namespace FIter {
 // 
 // This will print '0,1,2,'.
 
-template<typename IterT>
+template<typename IterT, typename func, typename SentT = IterT>
 class TakeWhileObject {
+  static_assert(std::is_invocable<const func&, decltype(*std::declval<const IterT&>())>::value,
+                "TakeWhile's function must be callable as const: a mutable lambda isn't");
 
-  typedef typename IterT::value_type value_type;
+  typedef typename std::iterator_traits<IterT>::value_type value_type;
   // Note: The following is necessary because TakeWhileObjects never support reverse iteration.
-  typedef typename least_iterator_type<typename IterT::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT>::iterator_category, std::forward_iterator_tag>::type least_common_subtype;
 
  protected:
   const IterT m_begin;
-  const IterT m_end;
+  const SentT m_end;
  
-  std::function<bool(value_type)> whilef;
+  func whilef;
 
 
  public:
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
-  public Iterator_base<least_common_subtype, const_iterator, value_type>
+  struct sentinel {};
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
+  public Iterator_base<least_common_subtype, const_iterator, value_type>,
+  public Function_base<func>
   {
+    // Like filter, takewhile stores the end, so that it never dereferences it.
     IterT m_cur;
-    std::function<bool(value_type)> whilef;
-    bool is_end;
+    SentT m_end;
+    bool is_end; // true once whilef has failed or the items have run out.
 
     // Get the iterator at the base of a chain of FIters. For example, if you apply a
     // filter to a vector, and then a map to the filter, calling this on the map will
@@ -61,43 +82,96 @@ class TakeWhileObject {
    
     value_type access() const { return *m_cur; }
 
+    void check() { // the only place whilef is called: once per item.
+      is_end = (m_cur == m_end || !this->fn()(*m_cur));
+    }
+
     void advance() {
 			++m_cur;
+			check();
+    }
+
+    bool reached(const sentinel&) const {
+      return is_end;
+    }
+
+    // Internal iteration: see _for_each in FIter.h. As with advance(), the current item has
+    // already been checked, and the predicate is called once on each item after it. An
+    // iterator e as the end stops the items at e.m_cur at the latest: if e is finished,
+    // that is where whilef failed, or the end of the pair.
+    static const IterT& end_of(const const_iterator&, const const_iterator& e) { return e.m_cur; }
+    static const SentT& end_of(const const_iterator& b, const sentinel&) { return b.m_end; }
+
+    template <class S, class Sink>
+    static auto push(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(b, e), bool()) {
+      if(b.is_end) return true;
+      if(!sink(*b.m_cur)) return false;
+      IterT next = b.m_cur;
+      const func& f = b.fn();
+      bool more = true;
+      _for_each(++next, end_of(b, e), [&](auto&& x) {
+        if(!f(x)) return false;
+        return more = sink(std::forward<decltype(x)>(x));
+      });
+      return more;
+    }
+
+    // The same, a block at a time: the block is cut short at the first item to fail. The
+    // original items are read up to a block ahead, but whilef still stops at that item.
+    // The scan of each block is traced (see Trace.h).
+    template <std::size_t N, class S, class Sink>
+    static auto push_batch(const const_iterator& b, const S& e, Sink& sink) -> decltype(end_of(b, e), bool()) {
+      if(b.is_end) return true;
+      value_type first = *b.m_cur;
+      if(!sink(&first, 1)) return false;
+      IterT next = b.m_cur;
+      const func& f = b.fn();
+      bool more = true;
+      _for_each_batch<N>(++next, end_of(b, e), [&](auto* items, std::size_t n) {
+        std::size_t passed = 0;
+        {
+          FITER_TRACE("TakeWhile");
+          while(passed < n && f(items[passed])) ++passed;
+        }
+        if(passed > 0) more = sink(items, passed);
+        return more && passed == n;
+      });
+      return more;
     }
     
     // TakeWhile handles comparisons differently, to support ending in the right place.
     bool operator==(const const_iterator& r) const {
-      if(r.is_end && !whilef(*m_cur)) {
-        return true;
-      }
-      else if(is_end && r.is_end) { // two end iterators are always identical
-        return true;
+      if(is_end || r.is_end) { // end iterators are identical to each other, and nothing else
+        return is_end == r.is_end;
       }
       else {
         return m_cur == r.m_cur;
       }
     }
 
-    const_iterator(const IterT & _cur, std::function<bool(value_type)> _whilef, bool _is_end) : m_cur(_cur), whilef(_whilef), is_end(_is_end)
-    {} 
+    const_iterator(const IterT & _cur, const SentT & _end, const func & _whilef) : Function_base<func>(_whilef), m_cur(_cur), m_end(_end)
+    { check(); } 
 
-    const_iterator(const const_iterator& r) :  m_cur(r.m_cur),  whilef(r.whilef), is_end(r.is_end)
+    const_iterator(const const_iterator& r) : Function_base<func>(r), m_cur(r.m_cur), m_end(r.m_end), is_end(r.is_end)
     {}
     
     const_iterator& operator=(const const_iterator& r)
-    { m_cur = r.m_cur; whilef = r.whilef; is_end = r.is_end; return *this; }
+    { Function_base<func>::operator=(r); m_cur = r.m_cur; m_end = r.m_end; is_end = r.is_end; return *this; }
   };
   
 
-  TakeWhileObject(IterT _begin, IterT _end, std::function<bool(value_type)> _whilef) : m_begin(_begin), m_end(_end), whilef(_whilef)
+  TakeWhileObject(IterT _begin, SentT _end, func _whilef) : m_begin(_begin), m_end(_end), whilef(_whilef)
   {}
    
   const_iterator begin() const {
-    return const_iterator(m_begin, whilef, false);
+    return const_iterator(m_begin, m_end, whilef);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end, whilef, true);
+  auto end() const { // finished straight away, without calling whilef
+    if constexpr (std::is_same<IterT, SentT>::value)
+      return const_iterator(m_end, m_end, whilef);
+    else
+      return sentinel();
   }
 };
 
@@ -108,8 +182,9 @@ class TakeWhileObject {
 
 
 // Stores a boolean function f. When called on a pair of iterators, returns a
-// TakeWhileObject which iterates between them until f(item) is false.
-// 'func' is 'std::function<bool, ValueT>', in this case.
+// TakeWhileObject which iterates between them until f(item) is false, or, for Sorted(f)
+// where the items can be searched, a TakeObject of the items before that.
+// 'func' is any type callable as 'bool(ValueT)', in this case.
 // Its purposes are to allow currying and implicit template instantiation.
 template <typename func>
 class TakeWhileOn {
@@ -118,9 +193,12 @@ class TakeWhileOn {
   
   TakeWhileOn(func _f) : f(_f) {}
   
-  template <typename IterT>
-  TakeWhileObject<IterT> operator() (IterT start, IterT end) {
-    return TakeWhileObject<IterT>(start, end, f);
+  template <typename IterT, typename SentT>
+  auto operator() (IterT start, SentT end) {
+    if constexpr (is_monotone<func>::value && is_jumpable<IterT, SentT>::value) // See Sorted.h.
+      return TakeObject<IterT, SentT>(start, end, _partition_point(start, end, f) - start);
+    else
+      return TakeWhileObject<IterT, func, SentT>(start, end, f);
   }
 };
 
@@ -130,16 +208,10 @@ class TakeWhileOn {
 
 // TakeWhile takes a boolean function and returns a TakeWhileOn<> storing that function.
 // Only necessary to allow implicit template instantiation and lambdas.
-// Two versions: this for callable objects, the next for function pointers.
+// Callable objects are stored as they are; functions decay to function pointers.
 template<typename F>
-auto TakeWhile(F f) -> TakeWhileOn<std::function<bool(typename function_traits<decltype(&F::operator())>::arg_type)> >
-{
-  return TakeWhileOn<std::function<bool(typename function_traits<decltype(&F::operator())>::arg_type)>>(f);
-}
-
-template<typename A>
-TakeWhileOn<std::function<bool(A)>> TakeWhile(bool(&f)(A)) {
-  return TakeWhileOn<std::function<bool(A)>>(f);
+TakeWhileOn<F> TakeWhile(F f) {
+  return TakeWhileOn<F>(f);
 }
 
 
@@ -0,0 +1,262 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Trace.h"
+
+namespace FIter {
+
+
+// A work-stealing thread pool, for the Parallel terminals.
+//
+// A pool of n threads does its work on n-1 threads of its own plus whichever thread is
+// waiting on the work, so a pool of one thread runs everything on the caller and never
+// starts a thread at all. Each of its threads has a queue of tasks: a thread runs tasks
+// from the back of its own queue (the ones it spawned most recently, whose data is still
+// in its cache), and when that is empty steals from the front of another's (the oldest,
+// and so, when work is split recursively, the largest). Threads outside the pool queue
+// their tasks with the first of its own threads.
+//
+// Tasks are spawned into a TaskGroup, and TaskGroup::wait() runs queued tasks until all
+// of the group's are done, so tasks may themselves spawn and wait without tying up a
+// thread. When there are none queued, it sleeps until one is, or until the group's last
+// task ends. If any of the group's tasks threw, wait() then rethrows the first exception;
+// the rest are dropped. (Tasks pushed on the pool directly mustn't throw.)
+//
+// ThreadPool::shared() is a pool as large as std::thread::hardware_concurrency().
+//
+
+// Usage example:
+//
+// FIter::ThreadPool pool(4);
+// FIter::TaskGroup g(pool);
+// long a, b;
+// g.spawn([&]{ a = work(0); });
+// b = work(1);
+// g.wait();
+
+class ThreadPool {
+ public:
+  typedef std::function<void()> Task;
+
+  explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) :
+    queues(threads > 0 ? threads : 1), stopping(false), queued(0)
+  {
+    for(std::size_t i = 1; i < queues.size(); ++i)
+      workers.emplace_back([this, i] { work(i); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for(auto& t : workers) t.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  std::size_t size() const { return queues.size(); }
+
+  static ThreadPool& shared() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  // Queues a task, with the current thread if it belongs to this pool. The count of queued
+  // tasks goes up first, so that it can't be taken down below 0 by the task's being run.
+  void push(Task t) {
+    Queue& q = queues[own_index()];
+    ++queued;
+    try {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(t));
+    }
+    catch(...) {
+      --queued;
+      throw;
+    }
+    if(workers.size() > 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex); // so the wakeup can't slip in before a worker sleeps
+      wake.notify_one();
+    }
+  }
+
+  // Runs one queued task, if there are any: the newest of this thread's own, or else the
+  // oldest of someone else's. Returns whether it found one.
+  bool run_one() {
+    Task t;
+    std::size_t own = own_index();
+    if(!pop_back(queues[own], t)) {
+      bool stolen = false;
+      for(std::size_t i = 1; i < queues.size() && !stolen; ++i)
+        stolen = pop_front(queues[(own + i) % queues.size()], t);
+      if(!stolen) return false;
+    }
+    FITER_TRACE("ThreadPool task");
+    t();
+    return true;
+  }
+
+  // Runs queued tasks until done() is true, and sleeps while there are none. Whatever makes
+  // done() true must call notify() after.
+  template <typename Done>
+  void run_until(const Done& done) {
+    while(!done()) {
+      if(run_one()) continue;
+      std::unique_lock<std::mutex> lock(sleep_mutex);
+      wake.wait(lock, [this, &done] { return done() || queued > 0; });
+    }
+  }
+
+  // Wakes the threads sleeping in run_until(), to check again (and the workers, which go
+  // back to sleep unless there are tasks).
+  void notify() {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    wake.notify_all();
+  }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<Queue> queues;
+  std::vector<std::thread> workers;
+  std::mutex sleep_mutex;
+  std::condition_variable wake;
+  bool stopping;
+  std::atomic<std::size_t> queued;
+
+  // The index of the current thread's queue: its own if it is one of this pool's, and
+  // the first otherwise.
+  static const ThreadPool*& current_pool() { static thread_local const ThreadPool* p = nullptr; return p; }
+  static std::size_t& current_index() { static thread_local std::size_t i = 0; return i; }
+
+  std::size_t own_index() const {
+    return current_pool() == this ? current_index() : 0;
+  }
+
+  bool pop_back(Queue& q, Task& t) {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if(q.tasks.empty()) return false;
+    t = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    --queued;
+    return true;
+  }
+
+  bool pop_front(Queue& q, Task& t) {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if(q.tasks.empty()) return false;
+    t = std::move(q.tasks.front());
+    q.tasks.pop_front();
+    --queued;
+    return true;
+  }
+
+  void work(std::size_t index) {
+    current_pool() = this;
+    current_index() = index;
+    trace_thread_name("ThreadPool worker");
+    while(true) {
+      if(run_one()) continue;
+      std::unique_lock<std::mutex> lock(sleep_mutex);
+      wake.wait(lock, [this] { return stopping || queued > 0; });
+      if(stopping) return;
+    }
+  }
+};
+
+
+
+// A set of tasks spawned on a pool, which can be waited on together.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool& _pool) : pool(_pool), pending(0) {}
+
+  // Waits, in case the caller didn't, since the tasks may refer to its locals. An exception
+  // from a task is dropped here, since it can't be thrown from a destructor: the caller
+  // either didn't wait, or is already unwinding from one of its own.
+  ~TaskGroup() { join(); }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  // In a pool of one thread, runs f straight away. f is copied into the task, so a callable
+  // which lives until wait() may be passed as std::ref(f): then the task is small enough
+  // not to be allocated.
+  template <typename F>
+  void spawn(F f) {
+    if(pool.size() == 1) {
+      run(f);
+      return;
+    }
+    ++pending;
+    try {
+      pool.push([this, f] { run(f); finish(); });
+    }
+    catch(...) {
+      finish();
+      throw;
+    }
+  }
+
+  // Runs queued tasks (this group's or any other's) until this group's are all done,
+  // sleeping only while none are queued, and then rethrows the first exception any of them
+  // threw.
+  void wait() {
+    join();
+    if(error) {
+      std::exception_ptr e = error;
+      error = nullptr;
+      std::rethrow_exception(e);
+    }
+  }
+
+ private:
+  ThreadPool& pool;
+  std::mutex mutex; // guards error
+  std::atomic<std::size_t> pending;
+  std::exception_ptr error;
+
+  // While this group's tasks run elsewhere, others' (or those they spawn) may be queued,
+  // so the wait goes on running them.
+  void join() {
+    pool.run_until([this] { return pending == 0; });
+  }
+
+  template <typename F>
+  void run(const F& f) {
+    try {
+      f();
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(!error) error = std::current_exception();
+    }
+  }
+
+  // The group may be destroyed as soon as pending is 0, so nothing touches it after.
+  void finish() {
+    ThreadPool& p = pool;
+    if(--pending == 0) p.notify();
+  }
+};
+
+
+}
+
+#endif
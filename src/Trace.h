@@ -0,0 +1,247 @@
+#ifndef FITER_TRACE_H
+#define FITER_TRACE_H
+
+#include <cerrno>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <system_error>
+
+#ifdef FITER_TRACING
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace FIter {
+
+
+// Timeline tracing.
+//
+// The point of this file. When FITER_TRACING is defined, the stages and terminals record
+// a span (a name, a thread, a start and a duration) for each batch they work on (see
+// _for_each_batch in FIter.h), each whole Fold, Collect or ForEach, each task run by a
+// ThreadPool, each piece of a Parallel terminal, and each time a Prefetch's producer or
+// consumer has to wait for the other. write_trace() then writes them out in the Chrome
+// trace-event format, which chrome://tracing and ui.perfetto.dev show as a timeline, one
+// row per thread: so overlap between threads, and stalls, can be seen directly.
+//
+// Items pushed one at a time (see _for_each) and pulled by iterators aren't traced, since
+// a span costs far more than most stages do per item. Spans are recorded into a buffer of
+// each thread's own, without locking; write_trace() may be called at any time, and writes
+// the spans finished so far.
+//
+// FITER_TRACE(name), with a string literal, traces the rest of the enclosing scope in the
+// same way, so that user code can appear on the timeline too. trace_thread_name() labels
+// the current thread's row.
+//
+// When FITER_TRACING isn't defined, FITER_TRACE expands to nothing, so tracing costs
+// nothing at all, and write_trace() writes a trace with no events.
+//
+// FITER_TRACING must be defined for a whole program (as with -DFITER_TRACING), or for
+// none of it, since it changes what the library's inline functions do: linking files
+// compiled with it to files compiled without it breaks the one-definition rule. (So
+// bench/trace.cc is built into a program of its own: see bench/Makefile.)
+//
+
+// Usage example:
+//
+// auto parsed = FIter::Map(parse_record)(log.begin(), log.end());
+// auto ahead = FIter::Prefetch()(parsed.begin(), parsed.end());
+// auto total = FIter::Fold(0L, add_record)(ahead);
+// FIter::write_trace("pipeline.json");
+//
+// This will write a trace showing the parsing and the adding on their two threads, and
+// where either waited on the other, when compiled with FITER_TRACING.
+
+#define FITER_TRACE_CAT2(a, b) a##b
+#define FITER_TRACE_CAT(a, b) FITER_TRACE_CAT2(a, b)
+
+#ifdef FITER_TRACING
+
+const bool tracing_enabled = true;
+
+#define FITER_TRACE(name) ::FIter::Trace_span FITER_TRACE_CAT(fiter_trace_span_, __LINE__)(name)
+
+struct Trace_event {
+  const char* name;
+  std::int64_t start; // ns since the trace began
+  std::int64_t duration;
+};
+
+// A thread's spans. Only its thread writes to it, appending to the last of a list of
+// fixed-size chunks and then publishing the new count, so that write_trace() can read
+// what has been published from any thread without stopping this one.
+struct Trace_buffer {
+  static const std::size_t chunk_size = 4096;
+
+  struct Chunk {
+    Trace_event events[chunk_size];
+    std::atomic<Chunk*> next{nullptr};
+  };
+
+  int tid;
+  std::atomic<const char*> name{nullptr};
+  std::unique_ptr<Chunk> first{new Chunk};
+  Chunk* last = first.get();
+  std::atomic<std::size_t> count{0};
+
+  explicit Trace_buffer(int _tid) : tid(_tid) {}
+
+  ~Trace_buffer() {
+    Chunk* c = first->next.load();
+    while(c) {
+      Chunk* next = c->next.load();
+      delete c;
+      c = next;
+    }
+  }
+
+  void append(const Trace_event& e) {
+    std::size_t n = count.load(std::memory_order_relaxed);
+    if(n > 0 && n % chunk_size == 0) {
+      Chunk* c = new Chunk;
+      last->next.store(c, std::memory_order_release);
+      last = c;
+    }
+    last->events[n % chunk_size] = e;
+    count.store(n + 1, std::memory_order_release);
+  }
+};
+
+// Every thread's buffer. Buffers are kept after their threads end, for write_trace().
+struct Trace_registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Trace_buffer>> buffers;
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+inline Trace_registry& _trace_registry() {
+  static Trace_registry registry;
+  return registry;
+}
+
+inline Trace_buffer& _trace_buffer() {
+  static thread_local Trace_buffer* buffer = nullptr;
+  if(!buffer) {
+    Trace_registry& r = _trace_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.buffers.emplace_back(new Trace_buffer((int)r.buffers.size() + 1));
+    buffer = r.buffers.back().get();
+  }
+  return *buffer;
+}
+
+inline std::int64_t _trace_now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _trace_registry().epoch).count();
+}
+
+// Records the time from its construction to its destruction. Use through FITER_TRACE.
+class Trace_span {
+  const char* m_name;
+  std::int64_t m_start;
+
+ public:
+  explicit Trace_span(const char* _name) : m_name(_name), m_start(_trace_now())
+  {}
+
+  ~Trace_span() {
+    _trace_buffer().append(Trace_event{m_name, m_start, _trace_now() - m_start});
+  }
+
+  Trace_span(const Trace_span&) = delete;
+  Trace_span& operator=(const Trace_span&) = delete;
+};
+
+// Labels the current thread's row of the timeline. The name must outlive the trace.
+inline void trace_thread_name(const char* name) {
+  _trace_buffer().name.store(name, std::memory_order_relaxed);
+}
+
+inline void _write_trace_string(std::ostream& out, const char* s) {
+  out << '"';
+  for(; *s; ++s) {
+    if(*s == '"' || *s == '\\') out << '\\' << *s;
+    else if((unsigned char)*s < 0x20) out << ' ';
+    else out << *s;
+  }
+  out << '"';
+}
+
+// Writes every span finished so far, as a Chrome trace-event JSON object.
+inline void write_trace(std::ostream& out) {
+  Trace_registry& r = _trace_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  bool first = true;
+  char line[128];
+  for(auto& b : r.buffers) {
+    if(const char* name = b->name.load(std::memory_order_relaxed)) {
+      out << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << b->tid << ", \"args\": {\"name\": ";
+      _write_trace_string(out, name);
+      out << "}}";
+      first = false;
+    }
+    std::size_t n = b->count.load(std::memory_order_acquire);
+    const Trace_buffer::Chunk* c = b->first.get();
+    for(std::size_t i = 0; i < n; ++i) {
+      if(i > 0 && i % Trace_buffer::chunk_size == 0) c = c->next.load(std::memory_order_acquire);
+      const Trace_event& e = c->events[i % Trace_buffer::chunk_size];
+      out << (first ? "\n" : ",\n") << "{\"name\": ";
+      _write_trace_string(out, e.name);
+      std::snprintf(line, sizeof line, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+        b->tid, e.start / 1000.0, e.duration / 1000.0);
+      out << line;
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+}
+
+// Forgets every span recorded so far. Only for when nothing is being traced.
+inline void clear_trace() {
+  Trace_registry& r = _trace_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for(auto& b : r.buffers) {
+    Trace_buffer::Chunk* c = b->first->next.exchange(nullptr);
+    while(c) {
+      Trace_buffer::Chunk* next = c->next.load();
+      delete c;
+      c = next;
+    }
+    b->last = b->first.get();
+    b->count.store(0, std::memory_order_release);
+  }
+}
+
+#else
+
+const bool tracing_enabled = false;
+
+#define FITER_TRACE(name)
+
+inline void trace_thread_name(const char*) {}
+
+inline void write_trace(std::ostream& out) {
+  out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": []}\n";
+}
+
+inline void clear_trace() {}
+
+#endif
+
+// The same, to a file. Throws std::system_error if it can't be written.
+inline void write_trace(const std::string& path) {
+  std::ofstream out(path);
+  if(out) write_trace(static_cast<std::ostream&>(out));
+  if(!out)
+    throw std::system_error(errno ? errno : EIO, std::generic_category(), path);
+}
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <iterator>
+#include <tuple>
 #include <utility>
 #include "FIter.h"
 
@@ -13,10 +14,22 @@ namespace FIter {
 // A 'zip' iterator.
 //
 // The point of this file. Given two iterators, it returns an iterator the elements of
-// which are pairs of elements from those iterators.
+// which are pairs of elements from those iterators. (For more than two, or for elements
+// which refer to the originals rather than copy them, see ZipNObject, below.)
 //
 // Create using Zip(), below.
 //
+// If both pairs are random access, so are these iterators. When each pair then also ends
+// in an iterator, or doesn't end (as for a Progression), end() is an iterator too, placed
+// at the end of the shorter pair.
+//
+// Otherwise the ends of the pairs may be sentinels of types SentT_1 and SentT_2 instead,
+// and end() is a sentinel holding both ends, since iteration stops as soon as either is
+// reached.
+//
+// If both pairs are sized (see FIter.h), or one is and the other is endless, this one is
+// sized, and size() is defined.
+//
 
 // Usage example:
 //
@@ -28,70 +41,107 @@ namespace FIter {
 // 
 // This will print '0,a;1,b;2,c;3,d;4,e;5,f;6,g;'
 
-template<typename IterT_1, typename IterT_2>
+template<typename IterT_1, typename IterT_2, typename SentT_1 = IterT_1, typename SentT_2 = IterT_2>
 class ZipObject {
 
 
 	// value_types 1 and 2 are those of the elements. value_type itself is the type stored
 	// by _this_ iterator.
 	
-	typedef typename IterT_1::value_type value_type_1;
-	typedef typename IterT_2::value_type value_type_2;
+	typedef typename std::iterator_traits<IterT_1>::value_type value_type_1;
+	typedef typename std::iterator_traits<IterT_2>::value_type value_type_2;
 
   typedef std::pair<value_type_1, value_type_2> value_type;
 
-	// TODO: For now we're only supporting forward iterators here, but there's no real reason why that should be so.
-  typedef typename least_iterator_type<typename IterT_1::iterator_category, typename IterT_2::iterator_category>::type least_common_subtype_p;
-  typedef typename least_iterator_type<least_common_subtype_p, std::forward_iterator_tag>::type least_common_subtype;
+	// Reverse iteration is only supported as part of random access.
+  typedef typename least_iterator_type<typename std::iterator_traits<IterT_1>::iterator_category, typename std::iterator_traits<IterT_2>::iterator_category>::type least_common_subtype_p;
+  typedef typename random_or_forward<least_common_subtype_p>::type least_common_subtype;
 
  protected:
   const IterT_1 m_begin_1;
-  const IterT_1 m_end_1;
+  const SentT_1 m_end_1;
   const IterT_2 m_begin_2;
-  const IterT_2 m_end_2;
+  const SentT_2 m_end_2;
 
 
  public:
-  struct const_iterator : public std::iterator<least_common_subtype, value_type>,
+  struct sentinel {
+    SentT_1 m_end_1;
+    SentT_2 m_end_2;
+  };
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
   public Iterator_base<least_common_subtype, const_iterator, value_type>
   {
     IterT_1 m_cur_1;
     IterT_2 m_cur_2;
 
    
-		const_iterator& operator++() { ++m_cur_1; ++m_cur_2; return *this; }
-		const_iterator operator++(int) { auto tmp = *this; ++m_cur_1; ++m_cur_2; return tmp;}  
-		value_type operator*() const { return std::make_pair(*m_cur_1, *m_cur_2); }  
-		value_type* operator->() const { return &(std::make_pair(*m_cur_1, *m_cur_2)); } // todo pretty sure this dangles.
+    // Keeps the pair alive for as long as the expression using operator-> lasts.
+    struct pointer {
+      value_type p;
+      const value_type* operator->() const { return &p; }
+    };
+
+		constexpr value_type access() const { return std::make_pair(*m_cur_1, *m_cur_2); }  
+		constexpr pointer operator->() const { return pointer{access()}; }
+
+		constexpr void advance() { ++m_cur_1; ++m_cur_2; }
+		constexpr void unadvance() { --m_cur_1; --m_cur_2; }
+		constexpr void advance(std::ptrdiff_t n) { m_cur_1 += n; m_cur_2 += n; }
+		constexpr std::ptrdiff_t distance_from(const const_iterator& r) const { return m_cur_1 - r.m_cur_1; }
 		
+		constexpr bool operator==(const const_iterator& r) const { return (m_cur_1 == r.m_cur_1 && m_cur_2 == r.m_cur_2); }
+		constexpr bool operator!=(const const_iterator& r) const { return !(operator==(r)); }
+
 		// end once EITHER ends.
-		bool operator==(const const_iterator& r) const { return (m_cur_1 == r.m_cur_1 || m_cur_2 == r.m_cur_2); }
-		bool operator!=(const const_iterator& r) const { return !(operator==(r)); }
+		constexpr bool reached(const sentinel& s) const { return (m_cur_1 == s.m_end_1 || m_cur_2 == s.m_end_2); }
+
+		template <class S_1 = SentT_1, class S_2 = SentT_2>
+		constexpr auto remaining(const sentinel& s) const -> decltype(std::ptrdiff_t(std::min(_length(m_cur_1, std::declval<const S_1&>()), _length(m_cur_2, std::declval<const S_2&>())))) {
+			return std::min(_length(m_cur_1, s.m_end_1), _length(m_cur_2, s.m_end_2));
+		}
 
 
    
 
-    const_iterator(const IterT_1& _cur_1, const IterT_2& _cur_2) : m_cur_1(_cur_1), m_cur_2(_cur_2)
+    constexpr const_iterator(const IterT_1& _cur_1, const IterT_2& _cur_2) : m_cur_1(_cur_1), m_cur_2(_cur_2)
     {} 
 
-    const_iterator(const const_iterator& r) : m_cur_1(r.m_cur_1), m_cur_2(r.m_cur_2)
+    constexpr const_iterator(const const_iterator& r) : m_cur_1(r.m_cur_1), m_cur_2(r.m_cur_2)
     {}
     
-    const_iterator& operator=(const const_iterator& r)
+    constexpr const_iterator& operator=(const const_iterator& r)
     { m_cur_1 = r.m_cur_1; m_cur_2 = r.m_cur_2; return *this; }
   };
   
 
-  ZipObject(IterT_1 _begin_1, IterT_1 _end_1, IterT_2 _begin_2, IterT_2 _end_2) :
+  constexpr ZipObject(IterT_1 _begin_1, SentT_1 _end_1, IterT_2 _begin_2, SentT_2 _end_2) :
   	m_begin_1(_begin_1), m_end_1(_end_1), m_begin_2(_begin_2), m_end_2(_end_2)
   {}
    
-  const_iterator begin() const {
+  constexpr const_iterator begin() const {
     return const_iterator(m_begin_1, m_begin_2);
   }
     
-  const_iterator end() const {
-   return const_iterator(m_end_1, m_end_2);
+  constexpr auto end() const { // See FIter.h for _length.
+    if constexpr (std::is_same<SentT_1, Unreachable>::value && std::is_same<SentT_2, Unreachable>::value) {
+      return Unreachable();
+    }
+    else if constexpr (is_jumpable<IterT_1, SentT_1>::value && is_jumpable<IterT_2, SentT_2>::value) {
+      std::ptrdiff_t length = std::min(_length(m_begin_1, m_end_1), _length(m_begin_2, m_end_2));
+      return const_iterator(m_begin_1 + length, m_begin_2 + length);
+    }
+    else
+      return sentinel{m_end_1, m_end_2};
+  }
+
+  template <class S_1 = SentT_1, class S_2 = SentT_2, class = typename std::enable_if<
+    (is_sized<IterT_1, S_1>::value || std::is_same<S_1, Unreachable>::value) &&
+    (is_sized<IterT_2, S_2>::value || std::is_same<S_2, Unreachable>::value) &&
+    !(std::is_same<S_1, Unreachable>::value && std::is_same<S_2, Unreachable>::value)>::type>
+  constexpr std::ptrdiff_t size() const { // See FIter.h for _length.
+    return std::min(_length(m_begin_1, m_end_1), _length(m_begin_2, m_end_2));
   }
 };
 
@@ -105,16 +155,16 @@ class ZipObject {
 // iterating over pairs, the first element of which is drawn from the first pair here and
 // the second of which is drawn from the second pair.
 // Its purposes are to allow currying and implicit template instantiation.
-template <typename IterT_1>
+template <typename IterT_1, typename SentT_1>
 struct ZipTo {
 	IterT_1 begin_1;
-	IterT_1 end_1;
+	SentT_1 end_1;
   
-  ZipTo(IterT_1 _begin_1, IterT_1 _end_1) : begin_1(_begin_1), end_1(_end_1) {}
+  constexpr ZipTo(IterT_1 _begin_1, SentT_1 _end_1) : begin_1(_begin_1), end_1(_end_1) {}
   
-  template <typename IterT_2>
-  ZipObject<IterT_1, IterT_2> operator() (IterT_2 begin_2, IterT_2 end_2) {
-    return ZipObject<IterT_1, IterT_2>(begin_1, end_1, begin_2, end_2);
+  template <typename IterT_2, typename SentT_2>
+  constexpr ZipObject<IterT_1, IterT_2, SentT_1, SentT_2> operator() (IterT_2 begin_2, SentT_2 end_2) {
+    return ZipObject<IterT_1, IterT_2, SentT_1, SentT_2>(begin_1, end_1, begin_2, end_2);
   }
 };
 
@@ -125,11 +175,187 @@ struct ZipTo {
 
 
 // Zip takes a pair of iterators and returns a ZipOn<> storing those itertors.
-// Only necessary to allow implicit template instantiation.
+// Only necessary to allow implicit template instantiation. (Not for ranges: see is_range in
+// FIter.h, and the Zip() for ranges below.)
+
+template<typename IterT_1, typename SentT_1, class = typename std::enable_if<!is_range<IterT_1>::value>::type>
+constexpr ZipTo<IterT_1, SentT_1> Zip(IterT_1 begin, SentT_1 end) {
+  return ZipTo<IterT_1, SentT_1>(begin, end);
+}
+
+
+
+
+
+
+
+// An N-ary 'zip' iterator.
+//
+// Given any number of pairs of iterators, of types IterT... ending in types SentT..., it
+// returns iterators whose elements are tuples of the elements of those pairs, as
+// references into them (or as values, where the original iterators return values, as
+// Map's do): so nothing is copied, and assigning through an element writes to the
+// original. operator-> gives a proxy holding the tuple, rather than a pointer.
+//
+// If all the pairs are random access, so are these iterators.
+//
+// If every pair is sized (see FIter.h) or endless, and not all are endless, the length of
+// the shortest is found once, when the object is made; iterators count their position, and
+// end() is an iterator at that length, so that iteration stops by comparing positions only.
+// The original iterators are then never compared at all. size() is defined.
+//
+// Otherwise end() is a sentinel holding every end (or an Unreachable, if all are endless),
+// and iteration stops as soon as any pair reaches its end.
+//
+// Create using Zip(), below, with two or more ranges.
+//
+
+// Usage example:
+//
+// std::vector<int> ids{1, 2, 3};
+// std::vector<double> prices{9.5, 3.0, 7.25};
+// std::vector<char> flags{'a', 'b', 'c'};
+// for(auto [id, price, flag] : FIter::Zip(ids, prices, flags))
+//   std::cout << id << ',' << price << ',' << flag << ';';
+//
+// This will print '1,9.5,a;2,3,b;3,7.25,c;'
+
+template <typename Iters, typename Sents>
+class ZipNObject;
+
+template <typename... IterT, typename... SentT>
+class ZipNObject<std::tuple<IterT...>, std::tuple<SentT...>> {
+
+  // reference is what this iterator's operator* returns: a tuple of what the originals'
+  // do. value_type is the same with the references removed.
+  typedef std::tuple<decltype(*std::declval<const IterT&>())...> reference;
+  typedef std::tuple<typename std::decay<decltype(*std::declval<const IterT&>())>::type...> value_type;
+
+  // Reverse iteration is only supported as part of random access.
+  static const bool all_random = (is_random_access<IterT>::value && ...);
+  typedef typename std::conditional<all_random, std::random_access_iterator_tag, std::forward_iterator_tag>::type least_common_subtype;
+
+  static const bool all_endless = (std::is_same<SentT, Unreachable>::value && ...);
+  static const bool counted = !all_endless && ((is_sized<IterT, SentT>::value || std::is_same<SentT, Unreachable>::value) && ...);
+
+ protected:
+  const std::tuple<IterT...> m_begin;
+  const std::tuple<SentT...> m_end;
+
+  std::ptrdiff_t m_length; // The shortest pair's, when counted.
+
+
+ public:
+  struct sentinel {
+    std::tuple<SentT...> m_end;
+  };
+
+  struct const_iterator : public Iterator_types<least_common_subtype, value_type>,
+  public Iterator_base<least_common_subtype, const_iterator, value_type>
+  {
+    std::tuple<IterT...> m_cur;
+    std::ptrdiff_t m_pos;
+
+    typedef ZipNObject::reference reference;
+
+    // Keeps the tuple alive for as long as the expression using operator-> lasts.
+    struct pointer {
+      reference r;
+      const reference* operator->() const { return &r; }
+    };
+
+    reference access() const {
+      return std::apply([](const IterT&... it) { return reference(*it...); }, m_cur);
+    }
+
+    reference operator*() const { return access(); }
+    pointer operator->() const { return pointer{access()}; }
+    reference operator[](std::ptrdiff_t n) const { return *(*this + n); }
+
+    void advance() { std::apply([](IterT&... it) { (++it, ...); }, m_cur); ++m_pos; }
+    void unadvance() { std::apply([](IterT&... it) { (--it, ...); }, m_cur); --m_pos; }
+    void advance(std::ptrdiff_t n) { std::apply([n](IterT&... it) { ((it += n), ...); }, m_cur); m_pos += n; }
+    std::ptrdiff_t distance_from(const const_iterator& r) const { return m_pos - r.m_pos; }
+
+    // Positions are enough for iterators over the same pairs, and are all there is to
+    // compare with end() when counted.
+    bool operator==(const const_iterator& r) const { return m_pos == r.m_pos; }
+    bool operator!=(const const_iterator& r) const { return m_pos != r.m_pos; }
+
+    // end once ANY ends.
+    bool reached(const sentinel& s) const {
+      return reached(s, std::index_sequence_for<IterT...>());
+    }
+
+    template <std::size_t... I>
+    bool reached(const sentinel& s, std::index_sequence<I...>) const {
+      return ((std::get<I>(m_cur) == std::get<I>(s.m_end)) || ...);
+    }
+
+
+   
+
+    const_iterator(const std::tuple<IterT...>& _cur, std::ptrdiff_t _pos) : m_cur(_cur), m_pos(_pos)
+    {}
+  };
+  
+
+  ZipNObject(const std::tuple<IterT...>& _begin, const std::tuple<SentT...>& _end) :
+    m_begin(_begin), m_end(_end), m_length(0)
+  {
+    if constexpr (counted)
+      m_length = length(std::index_sequence_for<IterT...>());
+  }
+   
+  const_iterator begin() const {
+    return const_iterator(m_begin, 0);
+  }
+    
+  auto end() const {
+    if constexpr (all_endless)
+      return Unreachable();
+    else if constexpr (counted && all_random)
+      return const_iterator(std::apply([this](const IterT&... it) { return std::tuple<IterT...>((it + m_length)...); }, m_begin), m_length);
+    else if constexpr (counted) // Only ever compared by position.
+      return const_iterator(m_begin, m_length);
+    else
+      return sentinel{m_end};
+  }
+
+  template <bool C = counted, class = typename std::enable_if<C>::type>
+  std::ptrdiff_t size() const {
+    return m_length;
+  }
+
+ private:
+  template <std::size_t... I>
+  std::ptrdiff_t length(std::index_sequence<I...>) const { // See FIter.h for _length.
+    return std::min({_length(std::get<I>(m_begin), std::get<I>(m_end))...});
+  }
+};
+
+
+
+
+
+
+
+// Zip also takes two or more ranges (anything with begin() and end()), and returns a
+// ZipNObject over all of them at once. Only their iterators are kept, so the ranges must
+// outlive it, and temporaries (which wouldn't) are rejected at compile time.
+template <typename Range>
+using _begin_of = decltype(std::declval<Range&>().begin());
+
+template <typename Range>
+using _end_of = decltype(std::declval<Range&>().end());
 
-template<typename IterT_1>
-ZipTo<IterT_1> Zip(IterT_1 begin, IterT_1 end) {
-  return ZipTo<IterT_1>(begin, end);
+template <typename Range_1, typename Range_2, typename... Ranges, class = typename std::enable_if<is_range<Range_1>::value>::type>
+ZipNObject<std::tuple<_begin_of<Range_1>, _begin_of<Range_2>, _begin_of<Ranges>...>, std::tuple<_end_of<Range_1>, _end_of<Range_2>, _end_of<Ranges>...>>
+Zip(Range_1&& r_1, Range_2&& r_2, Ranges&&... rs) {
+  static_assert(std::is_lvalue_reference<Range_1>::value && std::is_lvalue_reference<Range_2>::value && (std::is_lvalue_reference<Ranges>::value && ...),
+                "Zip keeps only the ranges' iterators, so it can't take a temporary range: name it first");
+  return ZipNObject<std::tuple<_begin_of<Range_1>, _begin_of<Range_2>, _begin_of<Ranges>...>, std::tuple<_end_of<Range_1>, _end_of<Range_2>, _end_of<Ranges>...>>(
+    std::make_tuple(r_1.begin(), r_2.begin(), rs.begin()...), std::make_tuple(r_1.end(), r_2.end(), rs.end()...));
 }
 
 